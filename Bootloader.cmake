@@ -1,89 +1,213 @@
-cmake_minimum_required(VERSION 3.5)
+cmake_minimum_required(VERSION 3.16)
 
 if(NOT DEFINED BUILD_BOARD)
     message(FATAL_ERROR "BUILD_BOARD CMake variable is not set")
 endif()
 
-# Function to build all applications
-function(build_all_apps)
-    # Build main app
-    message(STATUS "Building main application")
+# Build directory used by the board configuration (see boards/*.cfg)
+set(BOARD_BUILD_DIR "build.${BUILD_BOARD}")
+
+# Sub-applications, flashed to ota_0, ota_1, ... in this order
+set(SUB_APPS tic_tac_toe wifi_list calculator synth_piano game_of_life)
+
+# Hash of everything a (sub-)application build depends on, used to skip unchanged builds
+function(app_inputs_hash APP_DIR OUT_VAR)
+    file(GLOB_RECURSE inputs
+        LIST_DIRECTORIES false
+        "${APP_DIR}/main/*"
+        "${APP_DIR}/resources/*"
+    )
+    file(GLOB top_inputs LIST_DIRECTORIES false
+        "${APP_DIR}/CMakeLists.txt"
+        "${APP_DIR}/partitions.csv"
+        "${APP_DIR}/sdkconfig.defaults*"
+        # Generated from the defaults by the first build, then changed by menuconfig
+        "${APP_DIR}/sdkconfig"
+    )
+    list(APPEND inputs ${top_inputs} "${CMAKE_CURRENT_LIST_DIR}/boards/${BUILD_BOARD}.cfg")
+    # Images converted at configure time are outputs, not inputs
+    list(FILTER inputs EXCLUDE REGEX "/images/gen/")
+    list(SORT inputs)
+
+    set(digest "${BUILD_BOARD}")
+    foreach(input ${inputs})
+        file(SHA256 "${input}" input_hash)
+        file(RELATIVE_PATH input_rel "${APP_DIR}" "${input}")
+        string(APPEND digest ";${input_rel}=${input_hash}")
+    endforeach()
+    string(SHA256 digest_hash "${digest}")
+    set(${OUT_VAR} ${digest_hash} PARENT_SCOPE)
+endfunction()
+
+# Build one application, invoked as a separate cmake process by build_all_apps().
+# Writes "<result>;<seconds>" to app_build_result.txt in the build directory.
+# The inputs are hashed after the build, which creates or updates sdkconfig.
+function(build_app)
+    set(app_build_dir "${APP_DIR}/${BOARD_BUILD_DIR}")
+    file(MAKE_DIRECTORY "${app_build_dir}")
+    string(TIMESTAMP start_time "%s")
     execute_process(
-        COMMAND idf.py @boards/${BUILD_BOARD}.cfg build
-        WORKING_DIRECTORY ${CMAKE_SOURCE_DIR}
-        RESULT_VARIABLE build_main_result
+        COMMAND idf.py @${APP_CFG} build
+        WORKING_DIRECTORY ${APP_DIR}
+        RESULT_VARIABLE build_result
+        OUTPUT_FILE "${app_build_dir}/idf_build.log"
+        ERROR_FILE "${app_build_dir}/idf_build.log"
     )
-    if(NOT build_main_result EQUAL 0)
-        message(FATAL_ERROR "Failed to build main application")
+    string(TIMESTAMP end_time "%s")
+    math(EXPR elapsed "${end_time} - ${start_time}")
+    if(build_result EQUAL 0)
+        app_inputs_hash("${APP_DIR}" app_hash)
+        file(WRITE "${app_build_dir}/app_inputs.sha256" "${app_hash}")
     endif()
+    file(WRITE "${app_build_dir}/app_build_result.txt" "${build_result};${elapsed}")
+endfunction()
 
-    # List of sub-applications
-    set(SUB_APPS tic_tac_toe wifi_list calculator synth_piano game_of_life)
+# Function to build all applications
+# Independent builds run concurrently in batches of at most JOBS (-DJOBS=N).
+# Applications whose inputs did not change since the last successful build are skipped (-DFORCE=ON to rebuild).
+function(build_all_apps)
+    # Main app first, then the sub-applications
+    set(APP_NAMES esp32-graphical-bootloader ${SUB_APPS})
+    set(APP_DIRS ${CMAKE_CURRENT_LIST_DIR})
+    set(APP_CFGS boards/${BUILD_BOARD}.cfg)
+    foreach(APP ${SUB_APPS})
+        list(APPEND APP_DIRS ${CMAKE_CURRENT_LIST_DIR}/apps/${APP})
+        list(APPEND APP_CFGS ../../boards/${BUILD_BOARD}.cfg)
+    endforeach()
 
-    # Function to build each sub-application
-    function(build_app APP)
-        message(STATUS "Building ${APP}")
-        execute_process(
-            COMMAND idf.py @../../boards/${BUILD_BOARD}.cfg build
-            WORKING_DIRECTORY ${CMAKE_SOURCE_DIR}/apps/${APP}
-            RESULT_VARIABLE build_result
-        )
-        if(NOT build_result EQUAL 0)
-            message(FATAL_ERROR "Failed to build ${APP}")
+    if(NOT DEFINED JOBS)
+        cmake_host_system_information(RESULT cores QUERY NUMBER_OF_LOGICAL_CORES)
+        # Every idf.py build already runs ninja on all cores
+        math(EXPR JOBS "${cores} / 4")
+        if(JOBS LESS 1)
+            set(JOBS 1)
         endif()
-    endfunction()
+    endif()
 
-    # Build each sub-application
-    foreach(APP ${SUB_APPS})
-        build_app(${APP})
+    # Collect the builds which are out of date
+    set(pending)
+    list(LENGTH APP_NAMES app_count)
+    math(EXPR last_idx "${app_count} - 1")
+    foreach(idx RANGE 0 ${last_idx})
+        list(GET APP_NAMES ${idx} APP)
+        list(GET APP_DIRS ${idx} APP_DIR)
+        app_inputs_hash("${APP_DIR}" app_hash)
+        set(stamp_file "${APP_DIR}/${BOARD_BUILD_DIR}/app_inputs.sha256")
+        set(stamp "")
+        if(EXISTS "${stamp_file}")
+            file(READ "${stamp_file}" stamp)
+        endif()
+        if(NOT FORCE AND stamp STREQUAL app_hash AND EXISTS "${APP_DIR}/${BOARD_BUILD_DIR}/${APP}.bin")
+            message(STATUS "${APP}: up to date")
+        else()
+            file(REMOVE "${APP_DIR}/${BOARD_BUILD_DIR}/app_build_result.txt")
+            list(APPEND pending ${idx})
+        endif()
     endforeach()
+
+    list(LENGTH pending pending_count)
+    if(pending_count EQUAL 0)
+        return()
+    endif()
+    message(STATUS "Building ${pending_count} application(s) in batches of ${JOBS}")
+
+    # Commands of one execute_process() call run concurrently, so builds run in lock-step batches
+    # of JOBS: the next batch starts when the slowest build of the current one finished.
+    # execute_process() cannot start a build as soon as another one finishes.
+    string(TIMESTAMP total_start "%s")
+    set(failed)
+    while(pending_count GREATER 0)
+        set(batch)
+        set(commands)
+        foreach(n RANGE 1 ${JOBS})
+            if(pending_count EQUAL 0)
+                break()
+            endif()
+            list(POP_FRONT pending idx)
+            math(EXPR pending_count "${pending_count} - 1")
+            list(APPEND batch ${idx})
+            list(GET APP_DIRS ${idx} APP_DIR)
+            list(GET APP_CFGS ${idx} APP_CFG)
+            list(APPEND commands COMMAND ${CMAKE_COMMAND}
+                -DBUILD_BOARD=${BUILD_BOARD} -Daction=build_app
+                -DAPP_DIR=${APP_DIR} -DAPP_CFG=${APP_CFG}
+                -P ${CMAKE_CURRENT_LIST_FILE})
+        endforeach()
+
+        execute_process(${commands} OUTPUT_QUIET)
+
+        foreach(idx ${batch})
+            list(GET APP_NAMES ${idx} APP)
+            list(GET APP_DIRS ${idx} APP_DIR)
+            set(result_file "${APP_DIR}/${BOARD_BUILD_DIR}/app_build_result.txt")
+            set(result "1;0")
+            if(EXISTS "${result_file}")
+                file(READ "${result_file}" result)
+            endif()
+            list(GET result 0 build_result)
+            list(GET result 1 elapsed)
+            if(build_result EQUAL 0)
+                message(STATUS "${APP}: built in ${elapsed} s")
+            else()
+                message(STATUS "${APP}: FAILED after ${elapsed} s, see ${APP_DIR}/${BOARD_BUILD_DIR}/idf_build.log")
+                list(APPEND failed ${APP})
+            endif()
+        endforeach()
+    endwhile()
+    string(TIMESTAMP total_end "%s")
+    math(EXPR total_elapsed "${total_end} - ${total_start}")
+    message(STATUS "Build finished in ${total_elapsed} s")
+
+    if(failed)
+        message(FATAL_ERROR "Failed to build: ${failed}")
+    endif()
 endfunction()
 
-# Function to merge all binaries into a single .bin file
+# Function to merge all binaries into combined.bin, uf2.bin and a sparse segment list (merged/flash_args)
+# Offsets come from the generated partition table; SUB_APPS go to ota_0, ota_1, ... in order
+# and WAV files in apps/synth_piano/instruments are packed into the instruments partition.
 function(merge_binaries)
-    # Paths to binaries
-    set(BOOTLOADER_BIN "${CMAKE_SOURCE_DIR}/build/bootloader/bootloader.bin")
-    set(PARTITION_TABLE_BIN "${CMAKE_SOURCE_DIR}/build/partition_table/partition-table.bin")
-    set(MAIN_APP_BIN "${CMAKE_SOURCE_DIR}/build/esp32-graphical-bootloader.bin")
-    set(OTA_DATA_INITIAL_BIN "${CMAKE_SOURCE_DIR}/build/ota_data_initial.bin")
-
-    # List of sub-applications and corresponding flash addresses
-    set(SUB_APP_NAMES
-        tic_tac_toe
-        wifi_list
-        calculator
-        synth_piano
-        game_of_life
-    )
+    find_program(PYTHON NAMES python python3)
+    if(NOT PYTHON)
+        message(FATAL_ERROR "Python is required to merge binaries")
+    endif()
 
-    set(SUB_APP_ADDRS
-        0x220000
-        0x4E0000
-        0x7A0000
-        0xA60000
-        0xD20000
+    set(MERGE_CMD ${PYTHON} ${CMAKE_CURRENT_LIST_DIR}/tools/merge_images.py
+        --build-dir ${CMAKE_CURRENT_LIST_DIR}/${BOARD_BUILD_DIR}
     )
+    set(slot 0)
+    foreach(APP ${SUB_APPS})
+        list(APPEND MERGE_CMD --app ota_${slot}=${CMAKE_CURRENT_LIST_DIR}/apps/${APP}/${BOARD_BUILD_DIR}/${APP}.bin)
+        math(EXPR slot "${slot} + 1")
+    endforeach()
 
-    # Build command for esptool.py merge_bin
-    set(MERGE_CMD esptool.py --chip esp32s3 merge_bin -o ${CMAKE_SOURCE_DIR}/build/combined.bin
-        --flash_mode dio --flash_size 16MB
-        0x0 ${BOOTLOADER_BIN}
-        0x8000 ${PARTITION_TABLE_BIN}
-        0xf000 ${OTA_DATA_INITIAL_BIN}
-        0x20000 ${MAIN_APP_BIN}
-    )
+    # Sampled instruments for the synth piano go to the instruments data partition
+    file(GLOB INSTRUMENT_WAVS ${CMAKE_CURRENT_LIST_DIR}/apps/synth_piano/instruments/*.wav)
+    if(INSTRUMENT_WAVS)
+        # Size column of the instruments partition, e.g. 128K
+        file(STRINGS ${CMAKE_CURRENT_LIST_DIR}/partitions.csv instruments_entry REGEX "^instruments,")
+        string(REPLACE "," ";" instruments_fields "${instruments_entry}")
+        list(GET instruments_fields 4 instruments_size)
+        string(STRIP "${instruments_size}" instruments_size)
+        if(instruments_size MATCHES "^([0-9]+)K$")
+            math(EXPR instruments_size "${CMAKE_MATCH_1} * 1024")
+        elseif(instruments_size MATCHES "^([0-9]+)M$")
+            math(EXPR instruments_size "${CMAKE_MATCH_1} * 1024 * 1024")
+        endif()
 
-    # Append sub-application binaries and addresses
-    list(LENGTH SUB_APP_NAMES LENGTH_SUB_APP_NAMES)
-    math(EXPR LAST_IDX "${LENGTH_SUB_APP_NAMES} - 1")
-    foreach(APP_IDX RANGE 0 ${LAST_IDX})
-        list(GET SUB_APP_NAMES ${APP_IDX} APP)
-        list(GET SUB_APP_ADDRS ${APP_IDX} ADDR)
-        list(APPEND MERGE_CMD ${ADDR} ${CMAKE_SOURCE_DIR}/apps/${APP}/build/${APP}.bin)
-    endforeach()
+        set(INSTRUMENTS_BIN ${CMAKE_CURRENT_LIST_DIR}/${BOARD_BUILD_DIR}/instruments.bin)
+        execute_process(
+            COMMAND ${PYTHON} ${CMAKE_CURRENT_LIST_DIR}/tools/pack_instruments.py -o ${INSTRUMENTS_BIN}
+                --size ${instruments_size} ${INSTRUMENT_WAVS}
+            RESULT_VARIABLE pack_result
+        )
+        if(NOT pack_result EQUAL 0)
+            message(FATAL_ERROR "Failed to pack instruments")
+        endif()
+        list(APPEND MERGE_CMD --data instruments=${INSTRUMENTS_BIN})
+    endif()
 
-    # Execute merge command
-    message(STATUS "Merging binaries into combined.bin...")
+    message(STATUS "Merging binaries into ${BOARD_BUILD_DIR}...")
     execute_process(
         COMMAND ${MERGE_CMD}
         RESULT_VARIABLE merge_result
@@ -93,63 +217,36 @@ function(merge_binaries)
     endif()
 endfunction()
 
-# Function to merge all binaries into a single UF2 file
-function(merge_binaries_uf2)
-    # Paths to binaries
-    set(BOOTLOADER_BIN "${CMAKE_SOURCE_DIR}/build/bootloader/bootloader.bin")
-    set(PARTITION_TABLE_BIN "${CMAKE_SOURCE_DIR}/build/partition_table/partition-table.bin")
-    set(MAIN_APP_BIN "${CMAKE_SOURCE_DIR}/build/esp32-graphical-bootloader.bin")
-    set(OTA_DATA_INITIAL_BIN "${CMAKE_SOURCE_DIR}/build/ota_data_initial.bin")
-
-    # List of sub-applications and corresponding flash addresses
-    set(SUB_APP_NAMES
-        tic_tac_toe
-        wifi_list
-        calculator
-        synth_piano
-        game_of_life
-    )
-
-    set(SUB_APP_ADDRS
-        0x220000
-        0x4E0000
-        0x7A0000
-        0xA60000
-        0xD20000
-    )
+# Function to flash only the slots and sectors which changed since the last flash (-DPORT=<serial port>)
+# -DFROM_DEVICE=ON compares with the flash content of the device instead of the cached manifest.
+function(flash_changed)
+    find_program(PYTHON NAMES python python3)
+    if(NOT PYTHON)
+        message(FATAL_ERROR "Python is required to flash")
+    endif()
+    if(NOT DEFINED PORT)
+        message(FATAL_ERROR "PORT CMake variable is not set")
+    endif()
 
-    # Build command for esptool.py merge_bin with UF2 format
-    set(MERGE_CMD esptool.py --chip esp32s3 merge_bin --format uf2 -o ${CMAKE_SOURCE_DIR}/build/uf2.bin
-        --flash_mode dio --flash_size 16MB
-        0x0 ${BOOTLOADER_BIN}
-        0x8000 ${PARTITION_TABLE_BIN}
-        0xf000 ${OTA_DATA_INITIAL_BIN}
-        0x20000 ${MAIN_APP_BIN}
+    set(FLASH_CMD ${PYTHON} ${CMAKE_CURRENT_LIST_DIR}/tools/flash_changed.py
+        --merged-dir ${CMAKE_CURRENT_LIST_DIR}/${BOARD_BUILD_DIR}/merged
+        --port ${PORT}
     )
+    if(FROM_DEVICE)
+        list(APPEND FLASH_CMD --from-device)
+    endif()
 
-    # Append sub-application binaries and addresses
-    list(LENGTH SUB_APP_NAMES LENGTH_SUB_APP_NAMES)
-    math(EXPR LAST_IDX "${LENGTH_SUB_APP_NAMES} - 1")
-    foreach(APP_IDX RANGE 0 ${LAST_IDX})
-        list(GET SUB_APP_NAMES ${APP_IDX} APP)
-        list(GET SUB_APP_ADDRS ${APP_IDX} ADDR)
-        list(APPEND MERGE_CMD ${ADDR} ${CMAKE_SOURCE_DIR}/apps/${APP}/build/${APP}.bin)
-    endforeach()
-
-    # Execute merge command
-    message(STATUS "Merging binaries into uf2.bin...")
     execute_process(
-        COMMAND ${MERGE_CMD}
-        RESULT_VARIABLE merge_result
+        COMMAND ${FLASH_CMD}
+        RESULT_VARIABLE flash_result
     )
-    if(NOT merge_result EQUAL 0)
-        message(FATAL_ERROR "Failed to merge binaries into UF2")
+    if(NOT flash_result EQUAL 0)
+        message(FATAL_ERROR "Failed to flash")
     endif()
 endfunction()
 
 # Function to run all steps
 function(build_all)
-    select_board()
     build_all_apps()
     merge_binaries()
 endfunction()
@@ -157,14 +254,14 @@ endfunction()
 # Entry point
 if(DEFINED action)
     message(STATUS "Action specified: ${action}")
-    if(action STREQUAL "select_board")
-        select_board()
-    elseif(action STREQUAL "build_all_apps")
+    if(action STREQUAL "build_all_apps")
         build_all_apps()
-    elseif(action STREQUAL "merge_binaries")
+    elseif(action STREQUAL "build_app")
+        build_app()
+    elseif(action STREQUAL "merge_binaries" OR action STREQUAL "merge_binaries_uf2")
         merge_binaries()
-    elseif(action STREQUAL "merge_binaries_uf2")
-        merge_binaries_uf2()
+    elseif(action STREQUAL "flash_changed")
+        flash_changed()
     elseif(action STREQUAL "build_all")
         build_all()
     else()
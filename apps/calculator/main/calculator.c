@@ -8,12 +8,14 @@
 #include "esp_ota_ops.h"
 
 #define TAG "Calculator"
+#define KEY_DEBOUNCE_US 50000 // Only repeats of the same key are debounced
 
 static lv_obj_t *display_label;
 static char current_input[64] = "";
 static double stored_value = 0;
 static char current_operator = 0;
 static bool clear_next = false;
+static uint32_t last_btn_id = LV_BUTTONMATRIX_BUTTON_NONE;
 static int64_t last_press_time = 0;
 
 static void update_display() {
@@ -57,14 +59,20 @@ static void handle_operator(char operator) {
 }
 
 static void btn_event_cb(lv_event_t *e) {
+    lv_obj_t *btn = lv_event_get_target(e);
+    uint32_t btn_id = lv_btnmatrix_get_selected_btn(btn);
+
     int64_t now = esp_timer_get_time();
-    if (now - last_press_time < 500000) { // 500 ms debounce time
+    if (btn_id == last_btn_id && now - last_press_time < KEY_DEBOUNCE_US) {
         return;
     }
+    last_btn_id = btn_id;
     last_press_time = now;
 
-    lv_obj_t *btn = lv_event_get_target(e);
-    const char *txt = lv_btnmatrix_get_btn_text(btn, lv_btnmatrix_get_selected_btn(btn));
+    const char *txt = lv_btnmatrix_get_btn_text(btn, btn_id);
+    if (txt == NULL) {
+        return;
+    }
 
     if (strcmp(txt, "C") == 0) {
         clear_input();
@@ -126,6 +134,8 @@ void app_main(void) {
     lv_btnmatrix_set_map(btnm, btn_map);
     lv_obj_set_size(btnm, 320, 180);
     lv_obj_align(btnm, LV_ALIGN_CENTER, 0, 30);
+    // A held key must not repeat, each press enters one character
+    lv_buttonmatrix_set_button_ctrl_all(btnm, LV_BUTTONMATRIX_CTRL_NO_REPEAT);
     lv_obj_add_event_cb(btnm, btn_event_cb, LV_EVENT_VALUE_CHANGED, NULL);
 
     bsp_display_backlight_on();
@@ -1,103 +1,369 @@
 #include <stdio.h>
 // Conway's Game of Life for ESP32 using LVGL
 #include <stdlib.h>
+#include <string.h>
 #include <stdbool.h>
-#include <time.h>
+#include <inttypes.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/event_groups.h"
 #include "esp_log.h"
 #include "esp_system.h"
+#include "esp_random.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
 #include "lvgl.h"
 #include "bsp/esp-bsp.h"
 #include "esp_ota_ops.h"
+#include "life_engine.h"
+#include "life_world.h"
+#include "life_patterns.h"
 
 #define TAG "GameOfLife"
-#define GRID_SIZE 20
-#define CELL_SIZE 10
-#define CANVAS_WIDTH  (GRID_SIZE * CELL_SIZE)
-#define CANVAS_HEIGHT (GRID_SIZE * CELL_SIZE)
+#define CELL_SIZE 2
+// The grid (or the view of a large world) covers the display, its width rounded down to whole engine words
+#define GRID_WIDTH  ((BSP_LCD_H_RES / CELL_SIZE) / LIFE_WORD_BITS * LIFE_WORD_BITS)
+#define GRID_WORDS  (GRID_WIDTH / LIFE_WORD_BITS)
+#define GRID_HEIGHT (BSP_LCD_V_RES / CELL_SIZE)
+#define CANVAS_WIDTH  (GRID_WIDTH * CELL_SIZE)
+#define CANVAS_HEIGHT (GRID_HEIGHT * CELL_SIZE)
+#define GENERATION_PERIOD_MS 33
+// Rows per invalidated bounding box, LVGL keeps a limited number of dirty areas
+#define DIRTY_BAND_ROWS 16
+#define RANDOM_DENSITY 96
 
-static bool grid[GRID_SIZE][GRID_SIZE];
-static bool temp_grid[GRID_SIZE][GRID_SIZE];
+#if CONFIG_GAME_OF_LIFE_LARGE_WORLD
+#define WORLD_SIZE CONFIG_GAME_OF_LIFE_WORLD_SIZE
+#define SOUP_SIZE 512
+#define STATS_INTERVAL 100
+
+static life_world_t world;
+// Top left world cell shown on the canvas
+static int view_x;
+static int view_y;
+// Drag distance in pixels not applied to the view yet
+static volatile int pan_x;
+static volatile int pan_y;
+#else
+static life_grid_t grid;
+// Generation currently on the canvas, so stepping does not have to keep it
+static life_word_t *drawn;
+#endif
+
+#if CONFIG_GAME_OF_LIFE_PARALLEL
+#define STATS_INTERVAL 300
+#define STEP_WORKERS portNUM_PROCESSORS
+#define STEP_WORKERS_DONE ((1 << STEP_WORKERS) - 1)
+
+typedef struct {
+    TaskHandle_t task;
+    int first_row;
+    int last_row;
+    int64_t busy_us;            // time spent stepping since the last stats log
+} step_worker_t;
+
+static step_worker_t step_workers[STEP_WORKERS];
+// One bit per worker, all set once the generation is computed
+static EventGroupHandle_t step_done;
+#endif
 static lv_obj_t *canvas;
-lv_layer_t layer;
+static lv_draw_buf_t canvas_buf;
+static uint16_t color_alive;
+static uint16_t color_dead;
+static volatile bool reset_requested;
+// Set when the canvas does not show the previous generation
+static bool full_redraw = true;
 
 static void draw_grid();
-static void update_grid();
+
+#if CONFIG_GAME_OF_LIFE_LARGE_WORLD
+
+static void world_set_cell(void *ctx, int x, int y) {
+    life_world_set(&world, x % world.width, y % world.height, true);
+}
+
+// A random soup in the middle of the world with a glider gun next to it
+static void randomize_grid() {
+    int center_x = world.width / 2;
+    int center_y = world.height / 2;
+    life_world_clear(&world);
+    life_world_randomize(&world, center_x - SOUP_SIZE / 2, center_y - SOUP_SIZE / 2, SOUP_SIZE, SOUP_SIZE,
+                         esp_random, RANDOM_DENSITY);
+    life_pattern_place(life_pattern_find("gosper-gun"), center_x - SOUP_SIZE / 2 - 64, center_y - SOUP_SIZE / 2 - 32,
+                       world_set_cell, NULL);
+    view_x = center_x - GRID_WIDTH / 2;
+    view_y = center_y - GRID_HEIGHT / 2;
+}
+
+static void step_begin() {
+}
+
+static void step_end() {
+    life_world_step(&world);
+    if (world.generation % STATS_INTERVAL == 0) {
+        ESP_LOGI(TAG, "Generation %" PRIu32 ": %" PRIu32 " of %d tiles active", world.generation,
+                 world.active_tiles, world.tiles_x * world.tiles_y);
+    }
+}
+
+// Cells of a displayed row in the current generation and in the one drawn before
+static void view_row(int row, life_word_t *cells, life_word_t *previous) {
+    int y = (view_y + row) % world.height;
+    for (int word = 0; word < GRID_WORDS; ++word) {
+        int x = (view_x + word * LIFE_WORD_BITS) % world.width;
+        cells[word] = life_world_row_bits(&world, world.cells, x, y);
+        previous[word] = life_world_row_bits(&world, world.next, x, y);
+    }
+}
+
+// The previous generation stays in world.next until the next step
+static void view_row_drawn(int row, const life_word_t *cells) {
+}
+
+// Move the view by whole cells, return whether it moved
+static bool apply_pan() {
+    int dx = __atomic_exchange_n(&pan_x, 0, __ATOMIC_RELAXED);
+    int dy = __atomic_exchange_n(&pan_y, 0, __ATOMIC_RELAXED);
+    // Keep the sub-cell remainder for the next drag event
+    __atomic_add_fetch(&pan_x, dx % CELL_SIZE, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&pan_y, dy % CELL_SIZE, __ATOMIC_RELAXED);
+    dx /= CELL_SIZE;
+    dy /= CELL_SIZE;
+    if (dx == 0 && dy == 0) {
+        return false;
+    }
+    view_x = ((view_x - dx) % world.width + world.width) % world.width;
+    view_y = ((view_y - dy) % world.height + world.height) % world.height;
+    return true;
+}
+
+static void canvas_drag_event_cb(lv_event_t *e) {
+    lv_point_t vect;
+    lv_indev_get_vect(lv_indev_active(), &vect);
+    __atomic_add_fetch(&pan_x, vect.x, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&pan_y, vect.y, __ATOMIC_RELAXED);
+}
+
+#else
 
 static void randomize_grid() {
-    for (int row = 0; row < GRID_SIZE; ++row) {
-        for (int col = 0; col < GRID_SIZE; ++col) {
-            grid[row][col] = rand() % 2;
+    life_grid_randomize(&grid, esp_random, RANDOM_DENSITY);
+}
+
+#if CONFIG_GAME_OF_LIFE_PARALLEL
+
+static void step_worker_task(void *param) {
+    step_worker_t *worker = param;
+    EventBits_t done_bit = 1 << (worker - step_workers);
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        int64_t start = esp_timer_get_time();
+        life_grid_step_rows(&grid, worker->first_row, worker->last_row);
+        worker->busy_us += esp_timer_get_time() - start;
+        xEventGroupSetBits(step_done, done_bit);
+    }
+}
+
+// One worker per core, each computing its own band of rows
+static bool step_workers_start() {
+    step_done = xEventGroupCreate();
+    if (step_done == NULL) {
+        return false;
+    }
+    for (int i = 0; i < STEP_WORKERS; ++i) {
+        step_worker_t *worker = &step_workers[i];
+        char name[16];
+        snprintf(name, sizeof(name), "life_step%d", i);
+        worker->first_row = GRID_HEIGHT * i / STEP_WORKERS;
+        worker->last_row = GRID_HEIGHT * (i + 1) / STEP_WORKERS;
+        if (xTaskCreatePinnedToCore(step_worker_task, name, 4096, worker, 5, &worker->task, i) != pdPASS) {
+            return false;
         }
     }
+    return true;
+}
+
+// Start computing the next generation into grid.next, the current one can be drawn meanwhile
+static void step_begin() {
+    for (int i = 0; i < STEP_WORKERS; ++i) {
+        xTaskNotifyGive(step_workers[i].task);
+    }
+}
+
+// Wait for every band, then make the computed generation current
+static void step_end() {
+    static int64_t wait_us;
+    int64_t start = esp_timer_get_time();
+    xEventGroupWaitBits(step_done, STEP_WORKERS_DONE, pdTRUE, pdTRUE, portMAX_DELAY);
+    wait_us += esp_timer_get_time() - start;
+    life_grid_swap(&grid);
+
+    if (grid.generation % STATS_INTERVAL == 0) {
+        int64_t total_us = 0, max_us = 0;
+        for (int i = 0; i < STEP_WORKERS; ++i) {
+            ESP_LOGI(TAG, "Core %d: rows %d-%d, %" PRId64 " us/generation", i, step_workers[i].first_row,
+                     step_workers[i].last_row - 1, step_workers[i].busy_us / STATS_INTERVAL);
+            total_us += step_workers[i].busy_us;
+            if (step_workers[i].busy_us > max_us) {
+                max_us = step_workers[i].busy_us;
+            }
+            step_workers[i].busy_us = 0;
+        }
+        // Waiting time is what drawing did not hide, speedup is against one core doing all bands
+        ESP_LOGI(TAG, "Generation %" PRIu32 ": waited %" PRId64 " us/generation after drawing, speedup %.2f",
+                 grid.generation, wait_us / STATS_INTERVAL, max_us ? (double) total_us / max_us : 0.0);
+        wait_us = 0;
+    }
+}
+
+#else
+
+static void step_begin() {
 }
 
+static void step_end() {
+    life_grid_step(&grid);
+}
+
+#endif
+
+static void view_row(int row, life_word_t *cells, life_word_t *previous) {
+    memcpy(cells, &grid.cells[row * grid.words_per_row], GRID_WORDS * sizeof(life_word_t));
+    memcpy(previous, &drawn[row * grid.words_per_row], GRID_WORDS * sizeof(life_word_t));
+}
+
+static void view_row_drawn(int row, const life_word_t *cells) {
+    memcpy(&drawn[row * grid.words_per_row], cells, GRID_WORDS * sizeof(life_word_t));
+}
+
+static bool apply_pan() {
+    return false;
+}
+
+#endif
+
 static void reset_btn_event_cb(lv_event_t *e) {
     lv_event_code_t code = lv_event_get_code(e);
     if (code == LV_EVENT_CLICKED) {
-        randomize_grid();
+        // Applied by life_task between generations
+        reset_requested = true;
     }
 }
 
-static void draw_grid() {
-    bsp_display_lock(0);
-
-    lv_draw_rect_dsc_t rect_dsc;
-    lv_draw_rect_dsc_init(&rect_dsc);
-
-    for (int row = 0; row < GRID_SIZE; ++row) {
-        for (int col = 0; col < GRID_SIZE; ++col) {
-            lv_area_t area;
-            area.x1 = col * CELL_SIZE;
-            area.y1 = row * CELL_SIZE;
-            area.x2 = area.x1 + CELL_SIZE - 1;
-            area.y2 = area.y1 + CELL_SIZE - 1;
-            rect_dsc.bg_color = grid[row][col] ? lv_palette_main(LV_PALETTE_BLUE) : lv_color_white();
-            lv_draw_rect(&layer, &rect_dsc, &area);
+static void draw_cell(int x, int y, uint16_t color) {
+    uint32_t stride = canvas_buf.header.stride / sizeof(uint16_t);
+    uint16_t *px = (uint16_t *) canvas_buf.data + y * CELL_SIZE * stride + x * CELL_SIZE;
+    for (int i = 0; i < CELL_SIZE; ++i, px += stride) {
+        for (int j = 0; j < CELL_SIZE; ++j) {
+            px[j] = color;
         }
     }
+}
 
-    lv_canvas_finish_layer(canvas, &layer);
+// Write all cells straight into the RGB565 canvas buffer
+static void draw_full_grid() {
+    uint32_t stride = canvas_buf.header.stride / sizeof(uint16_t);
+    for (int row = 0; row < GRID_HEIGHT; ++row) {
+        uint16_t *line = (uint16_t *) canvas_buf.data + row * CELL_SIZE * stride;
+        life_word_t words[GRID_WORDS], previous[GRID_WORDS];
+        view_row(row, words, previous);
+        uint16_t *px = line;
+        for (int word = 0; word < GRID_WORDS; ++word) {
+            life_word_t bits = words[word];
+            for (int bit = 0; bit < LIFE_WORD_BITS; ++bit, bits >>= 1) {
+                uint16_t color = (bits & 1) ? color_alive : color_dead;
+                for (int i = 0; i < CELL_SIZE; ++i) {
+                    *px++ = color;
+                }
+            }
+        }
+        for (int i = 1; i < CELL_SIZE; ++i) {
+            memcpy(line + i * stride, line, CANVAS_WIDTH * sizeof(uint16_t));
+        }
+        view_row_drawn(row, words);
+    }
     lv_obj_invalidate(canvas);
-    bsp_display_unlock();
 }
 
-static void update_grid() {
-    for (int row = 0; row < GRID_SIZE; ++row) {
-        for (int col = 0; col < GRID_SIZE; ++col) {
-            int live_neighbors = 0;
-            for (int i = -1; i <= 1; ++i) {
-                for (int j = -1; j <= 1; ++j) {
-                    if (i == 0 && j == 0) continue;
-                    int r = row + i;
-                    int c = col + j;
-                    if (r >= 0 && r < GRID_SIZE && c >= 0 && c < GRID_SIZE) {
-                        live_neighbors += grid[r][c];
-                    }
+// Redraw only the cells which differ from the previously drawn generation
+// and invalidate the bounding box of the changes in each band of rows
+static void draw_changed_cells() {
+    lv_area_t coords;
+    lv_obj_get_coords(canvas, &coords);
+
+    for (int band = 0; band < GRID_HEIGHT; band += DIRTY_BAND_ROWS) {
+        int band_end = band + DIRTY_BAND_ROWS < GRID_HEIGHT ? band + DIRTY_BAND_ROWS : GRID_HEIGHT;
+        int x_min = GRID_WIDTH, x_max = -1, y_min = GRID_HEIGHT, y_max = -1;
+
+        for (int row = band; row < band_end; ++row) {
+            life_word_t cells[GRID_WORDS], previous[GRID_WORDS];
+            view_row(row, cells, previous);
+            for (int word = 0; word < GRID_WORDS; ++word) {
+                life_word_t changed = cells[word] ^ previous[word];
+                if (changed == 0) {
+                    continue;
                 }
-            }
+                int base = word * LIFE_WORD_BITS;
+                if (base + __builtin_ctz(changed) < x_min) {
+                    x_min = base + __builtin_ctz(changed);
+                }
+                if (base + LIFE_WORD_BITS - 1 - __builtin_clz(changed) > x_max) {
+                    x_max = base + LIFE_WORD_BITS - 1 - __builtin_clz(changed);
+                }
+                if (y_min > row) {
+                    y_min = row;
+                }
+                y_max = row;
 
-            if (grid[row][col]) {
-                temp_grid[row][col] = live_neighbors == 2 || live_neighbors == 3;
-            } else {
-                temp_grid[row][col] = live_neighbors == 3;
+                while (changed) {
+                    int bit = __builtin_ctz(changed);
+                    changed &= changed - 1;
+                    draw_cell(base + bit, row, (cells[word] >> bit) & 1 ? color_alive : color_dead);
+                }
             }
+            view_row_drawn(row, cells);
         }
-    }
 
-    for (int row = 0; row < GRID_SIZE; ++row) {
-        for (int col = 0; col < GRID_SIZE; ++col) {
-            grid[row][col] = temp_grid[row][col];
+        if (x_max >= 0) {
+            lv_area_t area = {
+                .x1 = coords.x1 + x_min * CELL_SIZE,
+                .y1 = coords.y1 + y_min * CELL_SIZE,
+                .x2 = coords.x1 + (x_max + 1) * CELL_SIZE - 1,
+                .y2 = coords.y1 + (y_max + 1) * CELL_SIZE - 1,
+            };
+            lv_obj_invalidate_area(canvas, &area);
         }
     }
 }
 
+static void draw_grid() {
+    bsp_display_lock(0);
+    if (full_redraw) {
+        full_redraw = false;
+        draw_full_grid();
+    } else {
+        draw_changed_cells();
+    }
+    bsp_display_unlock();
+}
+
+// Draws the current generation and then makes the next one current. With CONFIG_GAME_OF_LIFE_PARALLEL
+// the next generation is computed by the step workers while drawing.
 static void life_task(void *param) {
+    TickType_t last_wake = xTaskGetTickCount();
     while (1) {
-        vTaskDelay(pdMS_TO_TICKS(100));
-        update_grid();
+        vTaskDelayUntil(&last_wake, pdMS_TO_TICKS(GENERATION_PERIOD_MS));
+        if (reset_requested) {
+            reset_requested = false;
+            randomize_grid();
+            full_redraw = true;
+        }
+        if (apply_pan()) {
+            full_redraw = true;
+        }
+        step_begin();
         draw_grid();
+        step_end();
     }
 }
 
@@ -126,18 +392,51 @@ void app_main(void) {
     bsp_i2c_init();
     bsp_display_start();
     lv_init();
-    srand(time(NULL));
 
-    bsp_display_lock(0);
+#if CONFIG_GAME_OF_LIFE_LARGE_WORLD
+    if (!life_world_init(&world, WORLD_SIZE, WORLD_SIZE)) {
+        ESP_LOGE(TAG, "Not enough memory for a %dx%d world", WORLD_SIZE, WORLD_SIZE);
+        return;
+    }
+#else
+    drawn = calloc(GRID_WORDS * GRID_HEIGHT, sizeof(life_word_t));
+    if (!life_grid_init(&grid, GRID_WIDTH, GRID_HEIGHT) || drawn == NULL) {
+        ESP_LOGE(TAG, "Not enough memory for a %dx%d grid", GRID_WIDTH, GRID_HEIGHT);
+        return;
+    }
+#endif
+#if CONFIG_GAME_OF_LIFE_PARALLEL
+    if (!step_workers_start()) {
+        ESP_LOGE(TAG, "Failed to start the step workers");
+        return;
+    }
+#endif
 
-    LV_DRAW_BUF_DEFINE(draw_buf, CANVAS_WIDTH, CANVAS_HEIGHT, LV_COLOR_FORMAT_RGB565);
+    // The canvas covers the display, so prefer PSRAM when the board has it
+    uint32_t stride = lv_draw_buf_width_to_stride(CANVAS_WIDTH, LV_COLOR_FORMAT_RGB565);
+    uint32_t canvas_size = stride * CANVAS_HEIGHT;
+    void *canvas_data = heap_caps_malloc(canvas_size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (canvas_data == NULL) {
+        canvas_data = heap_caps_malloc(canvas_size, MALLOC_CAP_DEFAULT);
+    }
+    if (canvas_data == NULL) {
+        ESP_LOGE(TAG, "Not enough memory for the canvas");
+        return;
+    }
+    lv_draw_buf_init(&canvas_buf, CANVAS_WIDTH, CANVAS_HEIGHT, LV_COLOR_FORMAT_RGB565, stride, canvas_data, canvas_size);
+    color_alive = lv_color_to_u16(lv_palette_main(LV_PALETTE_BLUE));
+    color_dead = lv_color_to_u16(lv_color_white());
+
+    bsp_display_lock(0);
 
     canvas = lv_canvas_create(lv_scr_act());
-    lv_canvas_set_draw_buf(canvas, &draw_buf);
-    lv_canvas_fill_bg(canvas, lv_color_hex3(0xccc), LV_OPA_COVER);
+    lv_canvas_set_draw_buf(canvas, &canvas_buf);
     lv_obj_center(canvas);
-
-    lv_canvas_init_layer(canvas, &layer);
+#if CONFIG_GAME_OF_LIFE_LARGE_WORLD
+    // Drag to move the view over the world
+    lv_obj_add_flag(canvas, LV_OBJ_FLAG_CLICKABLE);
+    lv_obj_add_event_cb(canvas, canvas_drag_event_cb, LV_EVENT_PRESSING, NULL);
+#endif
 
     // Create a reset button
     lv_obj_t *reset_btn = lv_btn_create(lv_scr_act());
@@ -151,7 +450,7 @@ void app_main(void) {
 
     // Initialize grid
     randomize_grid();
-    printf("Grid initialized\n");
+    printf("Grid %dx%d initialized\n", GRID_WIDTH, GRID_HEIGHT);
     draw_grid();
     printf("Grid drawn\n");
 
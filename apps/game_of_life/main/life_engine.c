@@ -0,0 +1,73 @@
+#include <stdlib.h>
+#include <string.h>
+#include "life_engine.h"
+
+bool life_grid_init(life_grid_t *grid, int width, int height) {
+    memset(grid, 0, sizeof(*grid));
+    grid->words_per_row = width / LIFE_WORD_BITS;
+    grid->width = grid->words_per_row * LIFE_WORD_BITS;
+    grid->height = height;
+    if (grid->words_per_row == 0 || height < 3) {
+        return false;
+    }
+
+    size_t size = (size_t) grid->words_per_row * height * sizeof(life_word_t);
+    grid->cells = calloc(1, size);
+    grid->next = calloc(1, size);
+    if (grid->cells == NULL || grid->next == NULL) {
+        life_grid_free(grid);
+        return false;
+    }
+    return true;
+}
+
+void life_grid_free(life_grid_t *grid) {
+    free(grid->cells);
+    free(grid->next);
+    grid->cells = NULL;
+    grid->next = NULL;
+}
+
+void life_grid_clear(life_grid_t *grid) {
+    memset(grid->cells, 0, (size_t) grid->words_per_row * grid->height * sizeof(life_word_t));
+    grid->generation = 0;
+}
+
+void life_grid_randomize(life_grid_t *grid, uint32_t (*random32)(void), int density) {
+    for (int y = 0; y < grid->height; y++) {
+        for (int x = 0; x < grid->width; x++) {
+            life_grid_set(grid, x, y, (int) (random32() & 0xff) < density);
+        }
+    }
+    grid->generation = 0;
+}
+
+void life_grid_step_rows(life_grid_t *grid, int first, int last) {
+    const int words = grid->words_per_row;
+    const int last_word = words - 1;
+
+    for (int y = first; y < last; y++) {
+        const life_word_t *up = &grid->cells[(y == 0 ? grid->height - 1 : y - 1) * words];
+        const life_word_t *mid = &grid->cells[y * words];
+        const life_word_t *down = &grid->cells[(y == grid->height - 1 ? 0 : y + 1) * words];
+        life_word_t *out = &grid->next[y * words];
+
+        for (int i = 0; i < words; i++) {
+            out[i] = life_word_next(life_word_west(up, i, last_word), up[i], life_word_east(up, i, last_word),
+                                    life_word_west(mid, i, last_word), mid[i], life_word_east(mid, i, last_word),
+                                    life_word_west(down, i, last_word), down[i], life_word_east(down, i, last_word));
+        }
+    }
+}
+
+void life_grid_swap(life_grid_t *grid) {
+    life_word_t *cells = grid->cells;
+    grid->cells = grid->next;
+    grid->next = cells;
+    grid->generation++;
+}
+
+void life_grid_step(life_grid_t *grid) {
+    life_grid_step_rows(grid, 0, grid->height);
+    life_grid_swap(grid);
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+// Bit-packed Game of Life engine, one bit per cell, toroidal world
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define LIFE_WORD_BITS 32
+
+typedef uint32_t life_word_t;
+
+typedef struct {
+    int width;                  // multiple of LIFE_WORD_BITS
+    int height;
+    int words_per_row;
+    life_word_t *cells;         // current generation, bit x % 32 of word x / 32 is cell x
+    life_word_t *next;          // written by life_grid_step(), then swapped with cells
+    uint32_t generation;
+} life_grid_t;
+
+/*
+ * Next state of 32 cells at once. Each of the eight neighbour words holds one neighbour
+ * of every cell; they are summed bit-parallel with full adders into a count of
+ * ones + 2 * twos + 4 * fours, which is all the rule needs: alive when count is 3,
+ * or 2 for a live cell.
+ */
+static inline life_word_t life_word_next(life_word_t up_w, life_word_t up, life_word_t up_e,
+                                         life_word_t w, life_word_t mid, life_word_t e,
+                                         life_word_t down_w, life_word_t down, life_word_t down_e) {
+    // Per row: 2 bit count of the neighbours in that row
+    life_word_t up_ones = up_w ^ up ^ up_e;
+    life_word_t up_twos = (up_w & up) | (up_e & (up_w ^ up));
+    life_word_t mid_ones = w ^ e;
+    life_word_t mid_twos = w & e;
+    life_word_t down_ones = down_w ^ down ^ down_e;
+    life_word_t down_twos = (down_w & down) | (down_e & (down_w ^ down));
+
+    // Sum the ones, carry into the twos
+    life_word_t ones = up_ones ^ mid_ones ^ down_ones;
+    life_word_t ones_carry = (up_ones & mid_ones) | (down_ones & (up_ones ^ mid_ones));
+
+    // Sum the twos and the carry, anything above is four or more
+    life_word_t twos_sum = up_twos ^ mid_twos ^ down_twos;
+    life_word_t fours = (up_twos & mid_twos) | (down_twos & (up_twos ^ mid_twos));
+    life_word_t twos = twos_sum ^ ones_carry;
+    fours |= twos_sum & ones_carry;
+
+    return twos & ~fours & (ones | mid);
+}
+
+/* Word i of a row shifted so each bit holds its west (x - 1) neighbour, wrapping around */
+static inline life_word_t life_word_west(const life_word_t *row, int i, int last) {
+    return (row[i] << 1) | (row[i == 0 ? last : i - 1] >> (LIFE_WORD_BITS - 1));
+}
+
+/* Word i of a row shifted so each bit holds its east (x + 1) neighbour, wrapping around */
+static inline life_word_t life_word_east(const life_word_t *row, int i, int last) {
+    return (row[i] >> 1) | (row[i == last ? 0 : i + 1] << (LIFE_WORD_BITS - 1));
+}
+
+/* Allocate both generations, all cells dead. Width is rounded down to a multiple of LIFE_WORD_BITS. */
+bool life_grid_init(life_grid_t *grid, int width, int height);
+void life_grid_free(life_grid_t *grid);
+
+void life_grid_clear(life_grid_t *grid);
+/* Fill with random cells, density in 1/256 */
+void life_grid_randomize(life_grid_t *grid, uint32_t (*random32)(void), int density);
+
+static inline bool life_grid_get(const life_grid_t *grid, int x, int y) {
+    return (grid->cells[y * grid->words_per_row + x / LIFE_WORD_BITS] >> (x % LIFE_WORD_BITS)) & 1;
+}
+
+static inline void life_grid_set(life_grid_t *grid, int x, int y, bool alive) {
+    life_word_t *word = &grid->cells[y * grid->words_per_row + x / LIFE_WORD_BITS];
+    life_word_t mask = (life_word_t) 1 << (x % LIFE_WORD_BITS);
+    *word = alive ? (*word | mask) : (*word & ~mask);
+}
+
+/* Compute rows [first, last) of the next generation into grid->next */
+void life_grid_step_rows(life_grid_t *grid, int first, int last);
+
+/* Make the computed generation current */
+void life_grid_swap(life_grid_t *grid);
+
+/* One whole generation: life_grid_step_rows() over all rows and life_grid_swap() */
+void life_grid_step(life_grid_t *grid);
@@ -0,0 +1,68 @@
+#include <string.h>
+#include "life_patterns.h"
+
+static const char *const glider[] = {
+    ".O.",
+    "..O",
+    "OOO",
+};
+
+static const char *const r_pentomino[] = {
+    ".OO",
+    "OO.",
+    ".O.",
+};
+
+static const char *const acorn[] = {
+    ".O.....",
+    "...O...",
+    "OO..OOO",
+};
+
+static const char *const diehard[] = {
+    "......O.",
+    "OO......",
+    ".O...OOO",
+};
+
+static const char *const gosper_glider_gun[] = {
+    "........................O...........",
+    "......................O.O...........",
+    "............OO......OO............OO",
+    "...........O...O....OO............OO",
+    "OO........O.....O...OO..............",
+    "OO........O...O.OO....O.O...........",
+    "..........O.....O.......O...........",
+    "...........O...O....................",
+    "............OO......................",
+};
+
+const life_pattern_t life_patterns[] = {
+    { "glider", 3, 3, glider },
+    { "r-pentomino", 3, 3, r_pentomino },
+    { "acorn", 7, 3, acorn },
+    { "diehard", 8, 3, diehard },
+    { "gosper-gun", 36, 9, gosper_glider_gun },
+};
+
+const size_t life_pattern_count = sizeof(life_patterns) / sizeof(life_patterns[0]);
+
+const life_pattern_t *life_pattern_find(const char *name) {
+    for (size_t i = 0; i < life_pattern_count; i++) {
+        if (strcmp(life_patterns[i].name, name) == 0) {
+            return &life_patterns[i];
+        }
+    }
+    return NULL;
+}
+
+void life_pattern_place(const life_pattern_t *pattern, int x, int y,
+                        void (*set_cell)(void *ctx, int x, int y), void *ctx) {
+    for (int row = 0; row < pattern->height; row++) {
+        for (int col = 0; col < pattern->width; col++) {
+            if (pattern->rows[row][col] == 'O') {
+                set_cell(ctx, x + col, y + row);
+            }
+        }
+    }
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+// Well known Life patterns in plaintext form, 'O' is a live cell
+
+#include <stddef.h>
+
+typedef struct {
+    const char *name;
+    int width;
+    int height;
+    const char *const *rows;
+} life_pattern_t;
+
+extern const life_pattern_t life_patterns[];
+extern const size_t life_pattern_count;
+
+const life_pattern_t *life_pattern_find(const char *name);
+
+/* Call set_cell for every live cell of the pattern placed with its top left corner at x, y */
+void life_pattern_place(const life_pattern_t *pattern, int x, int y,
+                        void (*set_cell)(void *ctx, int x, int y), void *ctx);
@@ -0,0 +1,148 @@
+#include <stdlib.h>
+#include <string.h>
+#include "life_world.h"
+
+bool life_world_init(life_world_t *world, int width, int height) {
+    memset(world, 0, sizeof(*world));
+    world->tiles_x = width / LIFE_WORD_BITS;
+    world->tiles_y = height / LIFE_TILE_ROWS;
+    world->words_per_row = world->tiles_x;
+    world->width = world->tiles_x * LIFE_WORD_BITS;
+    world->height = world->tiles_y * LIFE_TILE_ROWS;
+    if (world->tiles_x == 0 || world->tiles_y == 0) {
+        return false;
+    }
+
+    // Large worlds end up in PSRAM through malloc
+    size_t size = (size_t) world->words_per_row * world->height * sizeof(life_word_t);
+    size_t tiles = (size_t) world->tiles_x * world->tiles_y;
+    world->cells = calloc(1, size);
+    world->next = calloc(1, size);
+    world->changed = calloc(1, tiles);
+    world->active = calloc(1, tiles);
+    if (world->cells == NULL || world->next == NULL || world->changed == NULL || world->active == NULL) {
+        life_world_free(world);
+        return false;
+    }
+    return true;
+}
+
+void life_world_free(life_world_t *world) {
+    free(world->cells);
+    free(world->next);
+    free(world->changed);
+    free(world->active);
+    world->cells = NULL;
+    world->next = NULL;
+    world->changed = NULL;
+    world->active = NULL;
+}
+
+void life_world_clear(life_world_t *world) {
+    size_t size = (size_t) world->words_per_row * world->height * sizeof(life_word_t);
+    memset(world->cells, 0, size);
+    memset(world->next, 0, size);
+    memset(world->changed, 0, (size_t) world->tiles_x * world->tiles_y);
+    world->generation = 0;
+    world->active_tiles = 0;
+}
+
+void life_world_set(life_world_t *world, int x, int y, bool alive) {
+    size_t index = (size_t) y * world->words_per_row + x / LIFE_WORD_BITS;
+    life_word_t mask = (life_word_t) 1 << (x % LIFE_WORD_BITS);
+    life_word_t word = alive ? (world->cells[index] | mask) : (world->cells[index] & ~mask);
+    // Both planes, so unchanged tiles keep next equal to cells
+    world->cells[index] = word;
+    world->next[index] = word;
+    world->changed[(y / LIFE_TILE_ROWS) * world->tiles_x + x / LIFE_WORD_BITS] = 1;
+}
+
+void life_world_randomize(life_world_t *world, int x, int y, int width, int height,
+                          uint32_t (*random32)(void), int density) {
+    for (int row = 0; row < height; row++) {
+        for (int col = 0; col < width; col++) {
+            life_world_set(world, (x + col) % world->width, (y + row) % world->height,
+                           (int) (random32() & 0xff) < density);
+        }
+    }
+}
+
+life_word_t life_world_row_bits(const life_world_t *world, const life_word_t *plane, int x, int y) {
+    const life_word_t *row = &plane[(size_t) y * world->words_per_row];
+    int word = x / LIFE_WORD_BITS;
+    int shift = x % LIFE_WORD_BITS;
+    if (shift == 0) {
+        return row[word];
+    }
+    int next_word = word + 1 == world->words_per_row ? 0 : word + 1;
+    return (row[word] >> shift) | (row[next_word] << (LIFE_WORD_BITS - shift));
+}
+
+/* Compute one tile into next, return whether any of its cells changed */
+static bool life_world_step_tile(life_world_t *world, int tx, int ty) {
+    const int words = world->words_per_row;
+    const int last_word = words - 1;
+    const int first_row = ty * LIFE_TILE_ROWS;
+    life_word_t changed = 0;
+
+    for (int y = first_row; y < first_row + LIFE_TILE_ROWS; y++) {
+        const life_word_t *up = &world->cells[(size_t) (y == 0 ? world->height - 1 : y - 1) * words];
+        const life_word_t *mid = &world->cells[(size_t) y * words];
+        const life_word_t *down = &world->cells[(size_t) (y == world->height - 1 ? 0 : y + 1) * words];
+        life_word_t out = life_word_next(life_word_west(up, tx, last_word), up[tx], life_word_east(up, tx, last_word),
+                                         life_word_west(mid, tx, last_word), mid[tx], life_word_east(mid, tx, last_word),
+                                         life_word_west(down, tx, last_word), down[tx], life_word_east(down, tx, last_word));
+        world->next[(size_t) y * words + tx] = out;
+        changed |= out ^ mid[tx];
+    }
+    return changed != 0;
+}
+
+/*
+ * Only tiles which changed in the last step, or border one which did, can change now.
+ * Every other tile is skipped: its cells and next planes already hold the same state,
+ * so swapping the planes keeps it correct.
+ */
+void life_world_step(life_world_t *world) {
+    const int tiles_x = world->tiles_x;
+    const int tiles_y = world->tiles_y;
+
+    memset(world->active, 0, (size_t) tiles_x * tiles_y);
+    for (int ty = 0; ty < tiles_y; ty++) {
+        for (int tx = 0; tx < tiles_x; tx++) {
+            if (!world->changed[ty * tiles_x + tx]) {
+                continue;
+            }
+            for (int dy = -1; dy <= 1; dy++) {
+                int ny = (ty + dy + tiles_y) % tiles_y;
+                for (int dx = -1; dx <= 1; dx++) {
+                    world->active[ny * tiles_x + (tx + dx + tiles_x) % tiles_x] = 1;
+                }
+            }
+        }
+    }
+
+    uint32_t active_tiles = 0;
+    for (int ty = 0; ty < tiles_y; ty++) {
+        for (int tx = 0; tx < tiles_x; tx++) {
+            int tile = ty * tiles_x + tx;
+            world->changed[tile] = world->active[tile] && life_world_step_tile(world, tx, ty);
+            active_tiles += world->active[tile];
+        }
+    }
+
+    life_word_t *cells = world->cells;
+    world->cells = world->next;
+    world->next = cells;
+    world->generation++;
+    world->active_tiles = active_tiles;
+}
+
+uint32_t life_world_population(const life_world_t *world) {
+    uint32_t population = 0;
+    size_t words = (size_t) world->words_per_row * world->height;
+    for (size_t i = 0; i < words; i++) {
+        population += __builtin_popcount(world->cells[i]);
+    }
+    return population;
+}
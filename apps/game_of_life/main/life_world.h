@@ -0,0 +1,45 @@
+#pragma once
+
+// Large toroidal Life world stepped tile by tile, skipping tiles where nothing can change
+
+#include "life_engine.h"
+
+// A tile is one word wide and LIFE_TILE_ROWS rows high
+#define LIFE_TILE_ROWS LIFE_WORD_BITS
+
+typedef struct {
+    int width;                  // multiples of LIFE_WORD_BITS and LIFE_TILE_ROWS
+    int height;
+    int words_per_row;
+    int tiles_x;
+    int tiles_y;
+    life_word_t *cells;         // current generation, row major like life_grid_t
+    life_word_t *next;          // previous generation for tiles changed by the last step, else equal to cells
+    uint8_t *changed;           // per tile, changed by the last step
+    uint8_t *active;            // per tile, to be computed by the next step
+    uint32_t generation;
+    uint32_t active_tiles;      // tiles computed by the last step
+} life_world_t;
+
+/* Allocate the world, all cells dead. Sizes are rounded down to whole tiles. */
+bool life_world_init(life_world_t *world, int width, int height);
+void life_world_free(life_world_t *world);
+void life_world_clear(life_world_t *world);
+
+static inline bool life_world_get(const life_world_t *world, int x, int y) {
+    return (world->cells[y * world->words_per_row + x / LIFE_WORD_BITS] >> (x % LIFE_WORD_BITS)) & 1;
+}
+
+/* Set a cell between steps. Its tile and the neighbouring tiles are computed by the next step. */
+void life_world_set(life_world_t *world, int x, int y, bool alive);
+
+/* Fill a rectangle with random cells, density in 1/256 */
+void life_world_randomize(life_world_t *world, int x, int y, int width, int height,
+                          uint32_t (*random32)(void), int density);
+
+/* 32 cells of row y starting at column x from the current (or previous) generation, wrapping around */
+life_word_t life_world_row_bits(const life_world_t *world, const life_word_t *plane, int x, int y);
+
+void life_world_step(life_world_t *world);
+
+uint32_t life_world_population(const life_world_t *world);
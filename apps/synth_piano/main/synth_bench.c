@@ -0,0 +1,85 @@
+#include <stdio.h>
+#include <string.h>
+#include "synth_bench.h"
+#include "synth_dsp.h"
+#include "synth_voice.h"
+
+// Samples per measurement, enough to hide the clock resolution
+#define BENCH_SAMPLES (1 << 20)
+
+typedef struct {
+    uint64_t (*now)(void);
+    double ticks_per_second;
+    double cpu_hz;
+} bench_clock_t;
+
+static SYNTH_DSP_ALIGN int16_t bench_a[SYNTH_MAX_BLOCK];
+static SYNTH_DSP_ALIGN int16_t bench_b[SYNTH_MAX_BLOCK];
+static synth_t bench_synth;
+
+static double cycles_per_sample(const bench_clock_t *clock, uint64_t ticks, double samples) {
+    return ticks / clock->ticks_per_second * clock->cpu_hz / samples;
+}
+
+static void print_kernel(const char *name, double cycles) {
+    printf("  %-8s %8.2f cycles/sample\n", name, cycles);
+}
+
+void synth_bench_run(uint64_t (*now)(void), double ticks_per_second, double cpu_hz, int block_size) {
+    const bench_clock_t clock = { now, ticks_per_second, cpu_hz };
+    const int blocks = BENCH_SAMPLES / block_size;
+    const double samples = (double) blocks * block_size;
+    synth_osc_t osc;
+    uint64_t start;
+
+    if (block_size > SYNTH_MAX_BLOCK) {
+        printf("Block size %d is above %d\n", block_size, SYNTH_MAX_BLOCK);
+        return;
+    }
+    synth_osc_init_tables();
+    synth_osc_start(&osc, SYNTH_WAVE_SAW, 440.0f);
+    printf("Synth kernels (%s), blocks of %d samples:\n", synth_dsp_backend(), block_size);
+
+    start = now();
+    for (int i = 0; i < blocks; ++i) {
+        synth_osc_render(&osc, bench_a, block_size, INT16_MAX / 2);
+    }
+    print_kernel("osc", cycles_per_sample(&clock, now() - start, samples));
+
+    start = now();
+    for (int i = 0; i < blocks; ++i) {
+        synth_dsp_gain_q15(bench_a, block_size, INT16_MAX - 1);
+    }
+    print_kernel("gain", cycles_per_sample(&clock, now() - start, samples));
+
+    start = now();
+    for (int i = 0; i < blocks; ++i) {
+        synth_dsp_ramp_q15(bench_a, block_size, 1 << 29, 1);
+    }
+    print_kernel("ramp", cycles_per_sample(&clock, now() - start, samples));
+
+    memset(bench_b, 0, sizeof(bench_b));
+    start = now();
+    for (int i = 0; i < blocks; ++i) {
+        synth_dsp_mix_q15(bench_b, bench_a, block_size);
+    }
+    print_kernel("mix", cycles_per_sample(&clock, now() - start, samples));
+
+    // Every voice held in its sustain stage, the usual state of a sounding note
+    const synth_adsr_t adsr = { .attack_ms = 5, .decay_ms = 50, .sustain = INT16_MAX / 2, .release_ms = 300 };
+    synth_init(&bench_synth, &adsr);
+    for (int i = 0; i < SYNTH_VOICES; ++i) {
+        synth_note_on(&bench_synth, i, 220.0f + 55.0f * i, (synth_wave_t) (i % SYNTH_WAVE_COUNT), NULL);
+    }
+    for (int i = 0; i < SYNTH_SAMPLE_RATE / 10 / block_size + 1; ++i) {
+        synth_render(&bench_synth, bench_a, block_size);
+    }
+    start = now();
+    for (int i = 0; i < blocks; ++i) {
+        synth_render(&bench_synth, bench_a, block_size);
+    }
+    double voice = cycles_per_sample(&clock, now() - start, samples * SYNTH_VOICES);
+    print_kernel("voice", voice);
+    printf("Voices per core at %d Hz: %.0f (%d configured)\n", SYNTH_SAMPLE_RATE,
+           cpu_hz / (SYNTH_SAMPLE_RATE * voice), SYNTH_VOICES);
+}
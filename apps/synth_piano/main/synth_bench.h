@@ -0,0 +1,12 @@
+#pragma once
+
+// Kernel benchmark shared by the app (CONFIG_SYNTH_PIANO_BENCHMARK) and host/synth
+
+#include <stdint.h>
+
+/*
+ * Time every kernel and a complete voice over blocks of block_size samples and print cycles per
+ * sample and the voices one core can mix at SYNTH_SAMPLE_RATE. now() counts ticks_per_second,
+ * cpu_hz converts times to cycles of the core running the benchmark.
+ */
+void synth_bench_run(uint64_t (*now)(void), double ticks_per_second, double cpu_hz, int block_size);
@@ -0,0 +1,111 @@
+#include <stdbool.h>
+#include "synth_dsp.h"
+#if CONFIG_SYNTH_PIANO_ESP_DSP
+#include "dsps_mulc.h"
+#include "dsps_add.h"
+#endif
+
+// dsps_add_s16() and dsps_mulc_s16() are the optimized versions only with esp-dsp optimizations
+// on. Otherwise they are the ANSI ones, and the add wraps, so the loops below are used instead.
+#if CONFIG_SYNTH_PIANO_ESP_DSP && CONFIG_DSP_OPTIMIZED
+#define SYNTH_DSP_ESP_ADD   dsps_add_s16_aes3_enabled
+#define SYNTH_DSP_ESP_MULC  (dsps_mulc_s16_ae32_enabled || dsps_mulc_s16_aes3_enabled)
+
+// The PIE kernels work on 16 byte vectors, esp-dsp falls back to C for anything else
+static inline bool vector_ok(const void *a, const void *b, int count) {
+    return count % SYNTH_DSP_VECTOR == 0 && ((uintptr_t) a | (uintptr_t) b) % 16 == 0;
+}
+#else
+#define SYNTH_DSP_ESP_ADD   0
+#define SYNTH_DSP_ESP_MULC  0
+#endif
+
+void synth_dsp_osc_q15(const int16_t *table, int table_bits, uint32_t *phase, uint32_t increment,
+                       int16_t gain, int16_t *out, int count) {
+    // A gather per sample, no vector form
+    const int index_shift = 32 - table_bits;
+    const int frac_shift = index_shift - 15;
+    uint32_t p = *phase;
+
+    for (int i = 0; i < count; ++i) {
+        uint32_t index = p >> index_shift;
+        int32_t frac = (p >> frac_shift) & 0x7fff;
+        int32_t a = table[index];
+        int32_t sample = a + (((table[index + 1] - a) * frac) >> 15);
+        out[i] = (int16_t) ((sample * gain) >> 15);
+        p += increment;
+    }
+    *phase = p;
+}
+
+int synth_dsp_resample_q15(const int16_t *data, uint32_t length, uint32_t loop_start, uint32_t loop_end,
+                           uint64_t *position, uint64_t step, int16_t gain, int16_t *out, int count) {
+    // Reads may come straight from mapped flash, no vector form either
+    const uint32_t end = loop_end ? loop_end : length;
+    const uint64_t loop_length = (uint64_t) (loop_end - loop_start) << 32;
+    uint64_t pos = *position;
+    int i;
+
+    for (i = 0; i < count; ++i) {
+        uint32_t index = pos >> 32;
+        if (index >= end) {
+            if (!loop_end) {
+                break;
+            }
+            while (index >= end) {
+                pos -= loop_length;
+                index = pos >> 32;
+            }
+        }
+        int32_t frac = (uint32_t) pos >> 17;
+        int32_t a = data[index];
+        int32_t b = index + 1 < end ? data[index + 1] : loop_end ? data[loop_start] : 0;
+        int32_t sample = a + (((b - a) * frac) >> 15);
+        out[i] = (int16_t) ((sample * gain) >> 15);
+        pos += step;
+    }
+    *position = pos;
+    return i;
+}
+
+void synth_dsp_gain_q15(int16_t *buf, int count, int16_t gain) {
+#if SYNTH_DSP_ESP_MULC
+    // Truncates the Q30 product like the loop below
+    if (vector_ok(buf, buf, count)) {
+        dsps_mulc_s16(buf, buf, count, gain, 1, 1);
+        return;
+    }
+#endif
+    for (int i = 0; i < count; ++i) {
+        buf[i] = (int16_t) ((buf[i] * gain) >> 15);
+    }
+}
+
+void synth_dsp_ramp_q15(int16_t *buf, int count, int32_t level, int32_t step) {
+    for (int i = 0; i < count; ++i) {
+        level += step;
+        buf[i] = (int16_t) ((buf[i] * (level >> 15)) >> 15);
+    }
+}
+
+void synth_dsp_mix_q15(int16_t *acc, const int16_t *in, int count) {
+#if SYNTH_DSP_ESP_ADD
+    // The PIE version saturates like the loop below
+    if (vector_ok(acc, in, count)) {
+        dsps_add_s16(acc, in, acc, count, 1, 1, 1, 0);
+        return;
+    }
+#endif
+    for (int i = 0; i < count; ++i) {
+        int32_t sum = acc[i] + in[i];
+        acc[i] = (int16_t) (sum > INT16_MAX ? INT16_MAX : sum < INT16_MIN ? INT16_MIN : sum);
+    }
+}
+
+const char *synth_dsp_backend(void) {
+#if CONFIG_SYNTH_PIANO_ESP_DSP
+    return "esp-dsp";
+#else
+    return "scalar";
+#endif
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+/*
+ * Q15 block kernels for the synth. The gain and mix kernels use the esp-dsp PIE versions on
+ * the ESP32-S3 (CONFIG_SYNTH_PIANO_ESP_DSP) when the buffers are 16 byte aligned and the
+ * count is a multiple of SYNTH_DSP_VECTOR, everything else runs the portable C loops.
+ */
+
+#include <stdint.h>
+#include "sdkconfig.h"
+
+#define SYNTH_DSP_VECTOR 8
+#define SYNTH_DSP_ALIGN __attribute__((aligned(16)))
+
+/* Wavetable lookup with linear interpolation, scaled by gain. The table has one extra entry
+ * repeating the first; phase is advanced by increment per sample. */
+void synth_dsp_osc_q15(const int16_t *table, int table_bits, uint32_t *phase, uint32_t increment,
+                       int16_t gain, int16_t *out, int count);
+
+/* Resample 16 bit PCM with linear interpolation, scaled by gain. position and step are Q32.32
+ * sample indices. Past loop_end the position wraps back to loop_start; without a loop
+ * (loop_end == 0) it stops at length. Returns the number of samples written. */
+int synth_dsp_resample_q15(const int16_t *data, uint32_t length, uint32_t loop_start, uint32_t loop_end,
+                           uint64_t *position, uint64_t step, int16_t gain, int16_t *out, int count);
+
+/* buf *= gain, truncated. Only INT16_MIN * INT16_MIN does not fit and wraps to INT16_MIN. */
+void synth_dsp_gain_q15(int16_t *buf, int count, int16_t gain);
+
+/* buf *= level, where the Q30 level is advanced by step before every sample */
+void synth_dsp_ramp_q15(int16_t *buf, int count, int32_t level, int32_t step);
+
+/* acc += in, saturating */
+void synth_dsp_mix_q15(int16_t *acc, const int16_t *in, int count);
+
+/* Name of the implementation in use, for logs and benchmarks */
+const char *synth_dsp_backend(void);
@@ -0,0 +1,61 @@
+#include <stdlib.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "synth_latency.h"
+
+static uint32_t samples[SYNTH_LATENCY_STAGES][SYNTH_LATENCY_WINDOW];
+static uint32_t recorded;
+static uint32_t late_blocks;
+static portMUX_TYPE lock = portMUX_INITIALIZER_UNLOCKED;
+
+static const char *const stage_names[SYNTH_LATENCY_STAGES] = { "enqueue", "dequeue", "codec" };
+
+void synth_latency_record(const uint32_t us[SYNTH_LATENCY_STAGES]) {
+    portENTER_CRITICAL(&lock);
+    for (int stage = 0; stage < SYNTH_LATENCY_STAGES; ++stage) {
+        samples[stage][recorded % SYNTH_LATENCY_WINDOW] = us[stage];
+    }
+    recorded++;
+    portEXIT_CRITICAL(&lock);
+}
+
+void synth_latency_late_block(void) {
+    portENTER_CRITICAL(&lock);
+    late_blocks++;
+    portEXIT_CRITICAL(&lock);
+}
+
+static int compare_u32(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *) a, y = *(const uint32_t *) b;
+    return x < y ? -1 : x > y;
+}
+
+void synth_latency_summary(synth_latency_stage_t stage, synth_latency_summary_t *summary) {
+    static uint32_t sorted[SYNTH_LATENCY_WINDOW];
+    portENTER_CRITICAL(&lock);
+    uint32_t count = recorded < SYNTH_LATENCY_WINDOW ? recorded : SYNTH_LATENCY_WINDOW;
+    memcpy(sorted, samples[stage], count * sizeof(uint32_t));
+    portEXIT_CRITICAL(&lock);
+
+    memset(summary, 0, sizeof(*summary));
+    if (count == 0) {
+        return;
+    }
+    qsort(sorted, count, sizeof(uint32_t), compare_u32);
+    uint64_t total = 0;
+    for (uint32_t i = 0; i < count; ++i) {
+        total += sorted[i];
+    }
+    summary->count = count;
+    summary->min_us = sorted[0];
+    summary->avg_us = total / count;
+    summary->p99_us = sorted[(count * 99) / 100 < count ? (count * 99) / 100 : count - 1];
+}
+
+uint32_t synth_latency_late_blocks(void) {
+    return late_blocks;
+}
+
+const char *synth_latency_stage_name(synth_latency_stage_t stage) {
+    return stage < SYNTH_LATENCY_STAGES ? stage_names[stage] : "?";
+}
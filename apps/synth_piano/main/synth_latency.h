@@ -0,0 +1,32 @@
+#pragma once
+
+// Touch to sound latency of the piano (CONFIG_SYNTH_PIANO_LATENCY_STATS)
+
+#include <stdint.h>
+
+typedef enum {
+    SYNTH_LATENCY_ENQUEUE,      // LVGL key event to note event queued
+    SYNTH_LATENCY_DEQUEUE,      // to the audio task picking it up
+    SYNTH_LATENCY_WRITTEN,      // to the first block with the note handed to the codec
+    SYNTH_LATENCY_STAGES,
+} synth_latency_stage_t;
+
+typedef struct {
+    uint32_t count;             // notes in the window, at most SYNTH_LATENCY_WINDOW
+    uint32_t min_us;
+    uint32_t avg_us;
+    uint32_t p99_us;
+} synth_latency_summary_t;
+
+// Summaries cover the last notes only
+#define SYNTH_LATENCY_WINDOW 256
+
+/* Record the stages of one note, each in microseconds since its LVGL event */
+void synth_latency_record(const uint32_t us[SYNTH_LATENCY_STAGES]);
+
+/* Count a block written after the codec queue had drained, i.e. the audio task fell behind */
+void synth_latency_late_block(void);
+
+void synth_latency_summary(synth_latency_stage_t stage, synth_latency_summary_t *summary);
+uint32_t synth_latency_late_blocks(void);
+const char *synth_latency_stage_name(synth_latency_stage_t stage);
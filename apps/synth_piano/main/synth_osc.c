@@ -0,0 +1,59 @@
+#include <math.h>
+#include "synth_osc.h"
+#include "synth_dsp.h"
+
+// Harmonics summed into the square and saw tables. More would alias on the top octaves.
+#define SYNTH_HARMONICS 24
+
+// One extra entry repeating the first, so interpolation never wraps
+static int16_t wave_tables[SYNTH_WAVE_COUNT][SYNTH_TABLE_SIZE + 1];
+
+static const char *const wave_names[SYNTH_WAVE_COUNT] = { "Sine", "Square", "Saw" };
+
+// Normalize a float cycle to full scale 16 bit
+static void store_table(int16_t *table, const float *cycle) {
+    float peak = 0;
+    for (int i = 0; i < SYNTH_TABLE_SIZE; ++i) {
+        peak = fmaxf(peak, fabsf(cycle[i]));
+    }
+    for (int i = 0; i < SYNTH_TABLE_SIZE; ++i) {
+        table[i] = (int16_t) lrintf(cycle[i] / peak * INT16_MAX);
+    }
+    table[SYNTH_TABLE_SIZE] = table[0];
+}
+
+void synth_osc_init_tables(void) {
+    static float cycle[SYNTH_WAVE_COUNT][SYNTH_TABLE_SIZE];
+    for (int i = 0; i < SYNTH_TABLE_SIZE; ++i) {
+        float x = 2.0f * (float) M_PI * i / SYNTH_TABLE_SIZE;
+        cycle[SYNTH_WAVE_SINE][i] = sinf(x);
+        // Additive square (odd harmonics) and saw (all harmonics) keep the tables band limited
+        float square = 0, saw = 0;
+        for (int h = 1; h <= SYNTH_HARMONICS; ++h) {
+            float partial = sinf(h * x) / h;
+            saw += partial;
+            if (h % 2) {
+                square += partial;
+            }
+        }
+        cycle[SYNTH_WAVE_SQUARE][i] = square;
+        cycle[SYNTH_WAVE_SAW][i] = saw;
+    }
+    for (int wave = 0; wave < SYNTH_WAVE_COUNT; ++wave) {
+        store_table(wave_tables[wave], cycle[wave]);
+    }
+}
+
+const char *synth_wave_name(synth_wave_t wave) {
+    return wave < SYNTH_WAVE_COUNT ? wave_names[wave] : "?";
+}
+
+void synth_osc_start(synth_osc_t *osc, synth_wave_t wave, float frequency) {
+    osc->table = wave_tables[wave < SYNTH_WAVE_COUNT ? wave : SYNTH_WAVE_SINE];
+    osc->phase = 0;
+    osc->increment = (uint32_t) (frequency * (4294967296.0f / SYNTH_SAMPLE_RATE));
+}
+
+void synth_osc_render(synth_osc_t *osc, int16_t *out, int count, int16_t gain) {
+    synth_dsp_osc_q15(osc->table, SYNTH_TABLE_BITS, &osc->phase, osc->increment, gain, out, count);
+}
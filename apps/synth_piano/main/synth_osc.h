@@ -0,0 +1,34 @@
+#pragma once
+
+// Wavetable oscillators with 32 bit phase accumulators, rendering blocks of 16 bit samples
+
+#include <stdint.h>
+
+#define SYNTH_SAMPLE_RATE 44100
+// log2 of the wavetable length
+#define SYNTH_TABLE_BITS 10
+#define SYNTH_TABLE_SIZE (1 << SYNTH_TABLE_BITS)
+
+typedef enum {
+    SYNTH_WAVE_SINE,
+    SYNTH_WAVE_SQUARE,
+    SYNTH_WAVE_SAW,
+    SYNTH_WAVE_COUNT,
+} synth_wave_t;
+
+typedef struct {
+    const int16_t *table;
+    uint32_t phase;             // position in the table, the top SYNTH_TABLE_BITS bits are the index
+    uint32_t increment;         // phase step per sample, frequency * 2^32 / SYNTH_SAMPLE_RATE
+} synth_osc_t;
+
+/* Fill the wavetables, once before any oscillator is started */
+void synth_osc_init_tables(void);
+
+const char *synth_wave_name(synth_wave_t wave);
+
+/* Restart the oscillator on a new note */
+void synth_osc_start(synth_osc_t *osc, synth_wave_t wave, float frequency);
+
+/* Write count samples scaled by gain (Q15, 32767 is full scale) */
+void synth_osc_render(synth_osc_t *osc, int16_t *out, int count, int16_t gain);
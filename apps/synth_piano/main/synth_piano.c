@@ -1,5 +1,6 @@
 #include <stdio.h>
 #include <math.h>
+#include <inttypes.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "esp_log.h"
@@ -9,22 +10,56 @@
 #include "esp_timer.h"
 #include "driver/i2s.h"
 #include "esp_ota_ops.h"
+#include "synth_voice.h"
+#include "synth_dsp.h"
+#include "synth_bench.h"
+#include "synth_latency.h"
 
 #define TAG "SynthPiano"
-#define SAMPLE_RATE 44100
+#define SAMPLE_RATE SYNTH_SAMPLE_RATE
 #define DEFAULT_VOLUME  90
+// About 5 ms of audio per block, the time between picking up a note event and hearing it.
+// A multiple of SYNTH_DSP_VECTOR so the vector kernels cover whole blocks.
+#define AUDIO_BLOCK_SAMPLES 224
+#define CHORD_NOTES 3
+#define AUDIO_BLOCK_US (AUDIO_BLOCK_SAMPLES * 1000000LL / SAMPLE_RATE)
+#define LATENCY_LOG_INTERVAL_MS 5000
 
 static lv_obj_t *octave_label;
 static int current_octave = 4;
-static int last_note_index = -1;
 static int last_octave_event = -1;
 static esp_codec_dev_handle_t spk_codec_dev = NULL;
-static QueueHandle_t tone_queue;
+static QueueHandle_t note_queue;
+// Waveforms in synth_wave_t order, then the sampled instruments
+static int current_sound = SYNTH_WAVE_SINE;
+static bool chord_mode;
+static synth_t synth;
+static SYNTH_DSP_ALIGN int16_t audio_block[AUDIO_BLOCK_SAMPLES];
+// Notes started by the key under the finger, released together
+static int held_notes[CHORD_NOTES];
+static int held_count;
+
+typedef enum {
+    NOTE_ON,
+    NOTE_OFF,
+} note_event_type_t;
 
 typedef struct {
+    note_event_type_t type;
+    int note;                   // semitones from C0
     float frequency;
-    int duration_ms;
-} tone_t;
+    synth_wave_t wave;
+    const synth_instrument_t *instrument;   // NULL to play the wave
+    int64_t event_us;           // LVGL key event
+    int64_t enqueue_us;
+} note_event_t;
+
+static const synth_adsr_t piano_adsr = {
+    .attack_ms = 5,
+    .decay_ms = 150,
+    .sustain = INT16_MAX / 2,
+    .release_ms = 300,
+};
 
 static void update_display() {
     char buffer[16];
@@ -34,56 +69,136 @@ static void update_display() {
     bsp_display_unlock();
 }
 
-static void play_tone(float frequency, int duration_ms) {
-    const int sample_rate = SAMPLE_RATE;
-    const int num_samples = (sample_rate * duration_ms) / 1000;
-    const float amplitude = 1.0;
+#if CONFIG_SYNTH_PIANO_LATENCY_STATS
+// Notes started in the block being written, recorded once the codec took it
+typedef struct {
+    int64_t event_us;
+    int64_t enqueue_us;
+    int64_t dequeue_us;
+} note_timing_t;
 
-    int16_t *samples = malloc(num_samples * sizeof(int16_t));
-    if (!samples) {
-        ESP_LOGE(TAG, "Failed to allocate memory for samples");
-        return;
+static void record_latency(const note_timing_t *timing, int count, int64_t written_us) {
+    for (int i = 0; i < count; ++i) {
+        uint32_t us[SYNTH_LATENCY_STAGES] = {
+            [SYNTH_LATENCY_ENQUEUE] = timing[i].enqueue_us - timing[i].event_us,
+            [SYNTH_LATENCY_DEQUEUE] = timing[i].dequeue_us - timing[i].event_us,
+            [SYNTH_LATENCY_WRITTEN] = written_us - timing[i].event_us,
+        };
+        synth_latency_record(us);
     }
+}
+#endif
 
-    for (int i = 0; i < num_samples; ++i) {
-        samples[i] = (int16_t)(amplitude * INT16_MAX * sinf(2.0f * M_PI * frequency * i / sample_rate));
+// Mixes all voices continuously, the codec write blocks until there is room for the next block
+static void audio_task(void *param) {
+    note_event_t event;
+#if CONFIG_SYNTH_PIANO_LATENCY_STATS
+    note_timing_t timing[8];
+    int64_t last_write_us = 0;
+#endif
+    while (1) {
+#if CONFIG_SYNTH_PIANO_LATENCY_STATS
+        int timed = 0;
+#endif
+        while (xQueueReceive(note_queue, &event, 0)) {
+            if (event.type == NOTE_ON) {
+                synth_note_on(&synth, event.note, event.frequency, event.wave, event.instrument);
+#if CONFIG_SYNTH_PIANO_LATENCY_STATS
+                if (timed < sizeof(timing) / sizeof(timing[0])) {
+                    timing[timed++] = (note_timing_t) { event.event_us, event.enqueue_us, esp_timer_get_time() };
+                }
+#endif
+            } else {
+                synth_note_off(&synth, event.note);
+            }
+        }
+        synth_render(&synth, audio_block, AUDIO_BLOCK_SAMPLES);
+#if CONFIG_SYNTH_PIANO_LATENCY_STATS
+        // More than a block period since the last write means the task ran slower than the audio
+        // it produces and ate into what the codec had queued
+        int64_t now = esp_timer_get_time();
+        if (last_write_us && now - last_write_us > AUDIO_BLOCK_US) {
+            synth_latency_late_block();
+        }
+#endif
+        esp_codec_dev_write(spk_codec_dev, audio_block, sizeof(audio_block));
+#if CONFIG_SYNTH_PIANO_LATENCY_STATS
+        last_write_us = esp_timer_get_time();
+        record_latency(timing, timed, last_write_us);
+#endif
     }
+}
 
-    esp_codec_dev_write(spk_codec_dev, samples, num_samples * sizeof(int16_t));
-    vTaskDelay(pdMS_TO_TICKS(duration_ms)); // Ensure the tone plays for the specified duration
+static float note_frequency(int note) {
+    static const float frequencies[12] = {
+        261.63, 277.18, 293.66, 311.13, 329.63, 349.23, 369.99, 392.00, 415.30, 440.00, 466.16, 493.88
+    };
+    return frequencies[note % 12] * powf(2.0f, note / 12 - 4);
+}
 
-    free(samples);
+static void send_note(note_event_type_t type, int note, int64_t event_us) {
+    note_event_t event = {
+        .type = type,
+        .note = note,
+        .frequency = note_frequency(note),
+        .wave = current_sound < SYNTH_WAVE_COUNT ? (synth_wave_t) current_sound : SYNTH_WAVE_SINE,
+        .instrument = synth_instrument_get(current_sound - SYNTH_WAVE_COUNT),
+        .event_us = event_us,
+        .enqueue_us = esp_timer_get_time(),
+    };
+    if (xQueueSend(note_queue, &event, 0) != pdTRUE) {
+        ESP_LOGW(TAG, "Note queue full");
+    }
 }
 
-static void tone_task(void *param) {
-    tone_t tone;
-    while (1) {
-        if (xQueueReceive(tone_queue, &tone, portMAX_DELAY)) {
-            play_tone(tone.frequency, tone.duration_ms);
-        }
+static void release_held_notes(int64_t event_us) {
+    for (int i = 0; i < held_count; ++i) {
+        send_note(NOTE_OFF, held_notes[i], event_us);
     }
+    held_count = 0;
 }
 
+// Note on when a key is pressed or the finger slides onto it, note off when it is left or released
 static void note_event_cb(lv_event_t *e) {
+    int64_t event_us = esp_timer_get_time();
+    lv_event_code_t code = lv_event_get_code(e);
+    if (code == LV_EVENT_RELEASED || code == LV_EVENT_PRESS_LOST) {
+        release_held_notes(event_us);
+        return;
+    }
+    if (code != LV_EVENT_VALUE_CHANGED) {
+        return;
+    }
+
     lv_obj_t *btn = lv_event_get_target(e);
     const char *txt = lv_btnmatrix_get_btn_text(btn, lv_btnmatrix_get_selected_btn(btn));
-
-    float frequencies[12] = {
-        261.63, 277.18, 293.66, 311.13, 329.63, 349.23, 369.99, 392.00, 415.30, 440.00, 466.16, 493.88
-    };
+    if (txt == NULL) {
+        return;
+    }
     int note_index = atoi(txt);
-    if (note_index == last_note_index) {
-        return; // Ignore repeated events for the same note
+    if (note_index < 0 || note_index >= 12) {
+        return;
+    }
+    int note = current_octave * 12 + note_index;
+    if (held_count > 0 && held_notes[0] == note) {
+        return; // Ignore repeated events for the same key
     }
-    last_note_index = note_index;
 
-    if (note_index >= 0 && note_index < 12) {
-        float frequency = frequencies[note_index] * powf(2.0f, current_octave - 4);
-        tone_t tone = { .frequency = frequency, .duration_ms = 250 };
-        xQueueSend(tone_queue, &tone, portMAX_DELAY); // Send tone to queue
+    release_held_notes(event_us);
+    // Major triad on the key in chord mode
+    static const int chord[CHORD_NOTES] = { 0, 4, 7 };
+    int notes = chord_mode ? CHORD_NOTES : 1;
+    for (int i = 0; i < notes; ++i) {
+        held_notes[held_count++] = note + chord[i];
+        send_note(NOTE_ON, note + chord[i], event_us);
     }
 }
 
+static void chord_event_cb(lv_event_t *e) {
+    lv_obj_t *btn = lv_event_get_target(e);
+    chord_mode = lv_obj_has_state(btn, LV_STATE_CHECKED);
+}
+
 static void octave_event_cb(lv_event_t *e) {
     lv_obj_t *btn = lv_event_get_target(e);
     const char *txt = lv_btnmatrix_get_btn_text(btn, lv_btnmatrix_get_selected_btn(btn));
@@ -102,6 +217,76 @@ static void octave_event_cb(lv_event_t *e) {
     update_display();
 }
 
+static void sound_event_cb(lv_event_t *e) {
+    lv_obj_t *dropdown = lv_event_get_target(e);
+    current_sound = lv_dropdown_get_selected(dropdown);
+}
+
+// Map the instruments partition for good, voices play the samples from flash through the cache
+static void load_instruments() {
+    const esp_partition_t *partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, "instruments");
+    if (partition == NULL) {
+        ESP_LOGI(TAG, "No instruments partition");
+        return;
+    }
+    const void *image;
+    esp_partition_mmap_handle_t handle;
+    esp_err_t ret = esp_partition_mmap(partition, 0, partition->size, ESP_PARTITION_MMAP_DATA, &image, &handle);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to map the instruments partition: %s", esp_err_to_name(ret));
+        return;
+    }
+    int count = synth_instruments_parse(image, partition->size);
+    if (count < 0) {
+        ESP_LOGI(TAG, "Instruments partition is empty, see tools/pack_instruments.py");
+        esp_partition_munmap(handle);
+        return;
+    }
+    for (int i = 0; i < count; ++i) {
+        const synth_instrument_t *instrument = synth_instrument_get(i);
+        ESP_LOGI(TAG, "Instrument %s: %" PRIu32 " samples at %" PRIu32 " Hz", instrument->name,
+                 instrument->length, instrument->sample_rate);
+    }
+}
+
+#if CONFIG_SYNTH_PIANO_LATENCY_STATS
+static lv_obj_t *latency_label;
+
+// Refresh the on-screen latency figures, and log them now and then, from the LVGL task
+static void latency_timer_cb(lv_timer_t *timer) {
+    static uint32_t last_logged_count, last_logged_late;
+    static int64_t last_log_us;
+    synth_latency_summary_t stages[SYNTH_LATENCY_STAGES];
+    for (int i = 0; i < SYNTH_LATENCY_STAGES; ++i) {
+        synth_latency_summary((synth_latency_stage_t) i, &stages[i]);
+    }
+    const synth_latency_summary_t *codec = &stages[SYNTH_LATENCY_WRITTEN];
+    uint32_t late = synth_latency_late_blocks();
+
+    lv_label_set_text_fmt(latency_label, "Latency %" PRIu32 "/%" PRIu32 "/%" PRIu32 " ms (min/avg/p99), late %" PRIu32,
+                          codec->min_us / 1000, codec->avg_us / 1000, codec->p99_us / 1000, late);
+
+    int64_t now = esp_timer_get_time();
+    if ((codec->count != last_logged_count || late != last_logged_late) && now - last_log_us >= LATENCY_LOG_INTERVAL_MS * 1000LL) {
+        for (int i = 0; i < SYNTH_LATENCY_STAGES; ++i) {
+            ESP_LOGI(TAG, "Latency to %-7s min %6" PRIu32 " avg %6" PRIu32 " p99 %6" PRIu32 " us (%" PRIu32 " notes)",
+                     synth_latency_stage_name((synth_latency_stage_t) i), stages[i].min_us, stages[i].avg_us,
+                     stages[i].p99_us, stages[i].count);
+        }
+        ESP_LOGI(TAG, "Late audio blocks: %" PRIu32, late);
+        last_logged_count = codec->count;
+        last_logged_late = late;
+        last_log_us = now;
+    }
+}
+#endif
+
+#if CONFIG_SYNTH_PIANO_BENCHMARK
+static uint64_t bench_now(void) {
+    return esp_timer_get_time();
+}
+#endif
+
 void app_audio_init(void)
 {
     /* Initialize speaker */
@@ -143,6 +328,12 @@ void app_main(void) {
     bsp_display_start();
     lv_init();
     app_audio_init();
+    synth_osc_init_tables();
+    synth_init(&synth, &piano_adsr);
+    load_instruments();
+#if CONFIG_SYNTH_PIANO_BENCHMARK
+    synth_bench_run(bench_now, 1000000.0, CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ * 1000000.0, AUDIO_BLOCK_SAMPLES);
+#endif
 
     // Create a label for the octave
     octave_label = lv_label_create(lv_scr_act());
@@ -161,6 +352,31 @@ void app_main(void) {
     lv_obj_align(octave_btnm, LV_ALIGN_TOP_RIGHT, 0, 0);
     lv_obj_add_event_cb(octave_btnm, octave_event_cb, LV_EVENT_VALUE_CHANGED, NULL);
 
+    // Create a drop-down for the sound: the waveforms in synth_wave_t order, then the instruments
+    static char sound_options[(SYNTH_WAVE_COUNT + SYNTH_MAX_INSTRUMENTS) * SYNTH_INSTRUMENT_NAME_SIZE];
+    int length = 0;
+    for (int i = 0; i < SYNTH_WAVE_COUNT; ++i) {
+        length += snprintf(sound_options + length, sizeof(sound_options) - length, "%s%s", i ? "\n" : "",
+                           synth_wave_name((synth_wave_t) i));
+    }
+    for (int i = 0; i < synth_instrument_count(); ++i) {
+        length += snprintf(sound_options + length, sizeof(sound_options) - length, "\n%s", synth_instrument_get(i)->name);
+    }
+
+    lv_obj_t *sound_dropdown = lv_dropdown_create(lv_scr_act());
+    lv_dropdown_set_options(sound_dropdown, sound_options);
+    lv_obj_set_size(sound_dropdown, 165, 40);
+    lv_obj_align(sound_dropdown, LV_ALIGN_TOP_LEFT, 0, 35);
+    lv_obj_add_event_cb(sound_dropdown, sound_event_cb, LV_EVENT_VALUE_CHANGED, NULL);
+
+    // Create a toggle which plays a major chord on every key
+    lv_obj_t *chord_btn = lv_btn_create(lv_scr_act());
+    lv_obj_t *chord_label = lv_label_create(chord_btn);
+    lv_label_set_text(chord_label, "Chord");
+    lv_obj_add_flag(chord_btn, LV_OBJ_FLAG_CHECKABLE);
+    lv_obj_align_to(chord_btn, octave_btnm, LV_ALIGN_OUT_LEFT_TOP, -5, 0);
+    lv_obj_add_event_cb(chord_btn, chord_event_cb, LV_EVENT_VALUE_CHANGED, NULL);
+
     // Create a button matrix for the notes
     static const char *note_map[] = {
         "0", "1", "2", "3", "\n",
@@ -172,14 +388,23 @@ void app_main(void) {
     lv_btnmatrix_set_map(note_btnm, note_map);
     lv_obj_set_size(note_btnm, 320, 150);
     lv_obj_align(note_btnm, LV_ALIGN_CENTER, 0, 30);
-    lv_obj_add_event_cb(note_btnm, note_event_cb, LV_EVENT_VALUE_CHANGED, NULL);
+    lv_obj_add_event_cb(note_btnm, note_event_cb, LV_EVENT_ALL, NULL);
 
-    // Create the tone queue
-    tone_queue = xQueueCreate(10, sizeof(tone_t));
-    assert(tone_queue != NULL);
+    // Create the note event queue
+    note_queue = xQueueCreate(16, sizeof(note_event_t));
+    assert(note_queue != NULL);
 
-    // Create the tone task
-    xTaskCreate(tone_task, "tone_task", 2048, NULL, 5, NULL);
+    // Create the audio task above the UI, it must never miss a block
+    xTaskCreate(audio_task, "audio_task", 4096, NULL, 10, NULL);
+
+#if CONFIG_SYNTH_PIANO_LATENCY_STATS
+    bsp_display_lock(0);
+    latency_label = lv_label_create(lv_scr_act());
+    lv_label_set_text(latency_label, "Latency: play a note");
+    lv_obj_align(latency_label, LV_ALIGN_BOTTOM_LEFT, 0, 0);
+    lv_timer_create(latency_timer_cb, 1000, NULL);
+    bsp_display_unlock();
+#endif
 
     bsp_display_backlight_on();
 
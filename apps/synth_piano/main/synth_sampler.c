@@ -0,0 +1,69 @@
+#include <math.h>
+#include <string.h>
+#include "synth_sampler.h"
+#include "synth_dsp.h"
+#include "synth_osc.h"
+
+#define FORMAT_PCM16 0
+
+static synth_instrument_t instruments[SYNTH_MAX_INSTRUMENTS];
+static int instrument_count;
+
+int synth_instruments_parse(const void *image, size_t size) {
+    const synth_instruments_header_t *header = image;
+    instrument_count = 0;
+    if (size < sizeof(*header) || memcmp(header->magic, SYNTH_INSTRUMENTS_MAGIC, sizeof(header->magic)) != 0 ||
+            header->version != SYNTH_INSTRUMENTS_VERSION || header->size > size ||
+            sizeof(*header) + (size_t) header->count * sizeof(synth_instrument_entry_t) > header->size) {
+        return -1;
+    }
+
+    const synth_instrument_entry_t *entries = (const synth_instrument_entry_t *) (header + 1);
+    for (int i = 0; i < header->count && instrument_count < SYNTH_MAX_INSTRUMENTS; ++i) {
+        const synth_instrument_entry_t *entry = &entries[i];
+        if (entry->format != FORMAT_PCM16 || entry->length < 2 || entry->offset % 2 ||
+                entry->offset + (uint64_t) entry->length * sizeof(int16_t) > header->size ||
+                (entry->loop_end && (entry->loop_start >= entry->loop_end || entry->loop_end > entry->length))) {
+            continue;
+        }
+        synth_instrument_t *instrument = &instruments[instrument_count++];
+        memcpy(instrument->name, entry->name, sizeof(instrument->name));
+        instrument->name[sizeof(instrument->name) - 1] = '\0';
+        instrument->samples = (const int16_t *) ((const uint8_t *) image + entry->offset);
+        instrument->length = entry->length;
+        instrument->loop_start = entry->loop_start;
+        instrument->loop_end = entry->loop_end;
+        instrument->sample_rate = entry->sample_rate;
+        instrument->root_note = entry->root_note;
+        // Done here rather than per note on, powf is slow on the audio task. A4 = 69 = 440 Hz
+        instrument->root_frequency = 440.0f * powf(2.0f, (entry->root_note - 69) / 12.0f);
+        instrument->step_per_hz = (float) ((double) entry->sample_rate / SYNTH_SAMPLE_RATE /
+                                           instrument->root_frequency * 4294967296.0);
+    }
+    return instrument_count;
+}
+
+int synth_instrument_count(void) {
+    return instrument_count;
+}
+
+const synth_instrument_t *synth_instrument_get(int index) {
+    return index >= 0 && index < instrument_count ? &instruments[index] : NULL;
+}
+
+void synth_sampler_start(synth_sampler_t *sampler, const synth_instrument_t *instrument, float frequency) {
+    sampler->instrument = instrument;
+    sampler->position = 0;
+    sampler->step = (uint64_t) (frequency * instrument->step_per_hz);
+}
+
+bool synth_sampler_render(synth_sampler_t *sampler, int16_t *out, int count, int16_t gain) {
+    const synth_instrument_t *instrument = sampler->instrument;
+    int written = synth_dsp_resample_q15(instrument->samples, instrument->length, instrument->loop_start,
+                                         instrument->loop_end, &sampler->position, sampler->step, gain, out, count);
+    if (written < count) {
+        memset(out + written, 0, (count - written) * sizeof(int16_t));
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+/*
+ * Sampled instruments packed by tools/pack_instruments.py. The image is used in place, usually
+ * through a memory mapped partition, so voices read the samples straight from flash.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define SYNTH_INSTRUMENTS_MAGIC "GBIN"
+#define SYNTH_INSTRUMENTS_VERSION 1
+#define SYNTH_MAX_INSTRUMENTS 8
+#define SYNTH_INSTRUMENT_NAME_SIZE 16
+
+typedef struct __attribute__((packed)) {
+    char magic[4];
+    uint16_t version;
+    uint16_t count;
+    uint32_t size;              // whole image
+} synth_instruments_header_t;
+
+typedef struct __attribute__((packed)) {
+    char name[SYNTH_INSTRUMENT_NAME_SIZE];
+    uint32_t offset;            // of the samples from the image start
+    uint32_t length;            // in samples
+    uint32_t loop_start;
+    uint32_t loop_end;          // 0 for a one shot sample
+    uint32_t sample_rate;
+    uint8_t root_note;          // MIDI note recorded at sample_rate
+    uint8_t format;             // 0: 16 bit mono PCM
+    uint16_t reserved;
+} synth_instrument_entry_t;
+
+typedef struct {
+    char name[SYNTH_INSTRUMENT_NAME_SIZE];
+    const int16_t *samples;
+    uint32_t length;
+    uint32_t loop_start;
+    uint32_t loop_end;
+    uint32_t sample_rate;
+    uint8_t root_note;
+    float root_frequency;       // of root_note, in Hz
+    float step_per_hz;          // Q32.32 sampler step per Hz played
+} synth_instrument_t;
+
+typedef struct {
+    const synth_instrument_t *instrument;
+    uint64_t position;          // Q32.32 index into the samples
+    uint64_t step;              // Q32.32 advance per output sample
+} synth_sampler_t;
+
+/* Check an instruments image and index it, return the number of instruments or -1 when invalid.
+ * The image must stay accessible while the instruments are used. */
+int synth_instruments_parse(const void *image, size_t size);
+
+int synth_instrument_count(void);
+const synth_instrument_t *synth_instrument_get(int index);
+
+/* Start playing the instrument at frequency, pitch shifted from its root note */
+void synth_sampler_start(synth_sampler_t *sampler, const synth_instrument_t *instrument, float frequency);
+
+/* Write count samples scaled by gain. Returns false when a one shot sample has ended, the rest
+ * of out is then silence. */
+bool synth_sampler_render(synth_sampler_t *sampler, int16_t *out, int count, int16_t gain);
@@ -0,0 +1,180 @@
+#include <string.h>
+#include "synth_voice.h"
+#include "synth_dsp.h"
+
+#define ENV_FULL (1 << 30)
+
+static int32_t ms_to_samples(int ms) {
+    int32_t samples = ms * SYNTH_SAMPLE_RATE / 1000;
+    return samples > 0 ? samples : 1;
+}
+
+static void env_release(synth_env_t *env, const synth_adsr_t *adsr) {
+    if (env->stage == SYNTH_ENV_IDLE || env->stage == SYNTH_ENV_RELEASE) {
+        return;
+    }
+    env->stage = SYNTH_ENV_RELEASE;
+    // Linear to zero from wherever the envelope is now
+    env->step = -(env->level / ms_to_samples(adsr->release_ms) + 1);
+}
+
+/* Samples until the level reaches target moving by step, at least 1 */
+static int env_segment(int32_t level, int32_t target, int32_t step) {
+    int32_t distance = step > 0 ? target - level : level - target;
+    int32_t speed = step > 0 ? step : -step;
+    if (distance <= 0 || speed == 0) {
+        return 1;
+    }
+    return (distance + speed - 1) / speed;
+}
+
+/*
+ * Advance the envelope over a block and scale the samples by it. Each stage is a linear
+ * segment handed to the ramp kernel in one piece; the sample reaching the end of a stage
+ * is clamped to the stage target.
+ */
+static void env_apply(synth_env_t *env, const synth_adsr_t *adsr, int16_t *samples, int count) {
+    const int32_t sustain = (int32_t) adsr->sustain << 15;
+
+    while (count > 0) {
+        int32_t target;
+        switch (env->stage) {
+        case SYNTH_ENV_ATTACK:
+            target = ENV_FULL;
+            break;
+        case SYNTH_ENV_DECAY:
+            target = sustain;
+            break;
+        case SYNTH_ENV_RELEASE:
+            target = 0;
+            break;
+        case SYNTH_ENV_SUSTAIN:
+            synth_dsp_gain_q15(samples, count, (int16_t) (env->level >> 15));
+            return;
+        default:
+            memset(samples, 0, count * sizeof(int16_t));
+            return;
+        }
+
+        int segment = env_segment(env->level, target, env->step);
+        if (segment > count) {
+            synth_dsp_ramp_q15(samples, count, env->level, env->step);
+            env->level += env->step * count;
+            return;
+        }
+        synth_dsp_ramp_q15(samples, segment - 1, env->level, env->step);
+        samples += segment - 1;
+        count -= segment - 1;
+
+        env->level = target;
+        samples[0] = (int16_t) ((samples[0] * (target >> 15)) >> 15);
+        samples++;
+        count--;
+        switch (env->stage) {
+        case SYNTH_ENV_ATTACK:
+            env->stage = SYNTH_ENV_DECAY;
+            env->step = -((ENV_FULL - sustain) / ms_to_samples(adsr->decay_ms) + 1);
+            break;
+        case SYNTH_ENV_DECAY:
+            env->stage = SYNTH_ENV_SUSTAIN;
+            env->step = 0;
+            break;
+        default:
+            env->stage = SYNTH_ENV_IDLE;
+            env->step = 0;
+            break;
+        }
+    }
+}
+
+void synth_init(synth_t *synth, const synth_adsr_t *adsr) {
+    memset(synth, 0, sizeof(*synth));
+    synth->adsr = *adsr;
+    // Four voices at full level reach full scale, more are saturated
+    synth->voice_gain = INT16_MAX / 4;
+}
+
+static synth_voice_t *find_voice(synth_t *synth, int note) {
+    synth_voice_t *free_voice = NULL, *released = NULL, *oldest = NULL;
+    for (int i = 0; i < SYNTH_VOICES; ++i) {
+        synth_voice_t *voice = &synth->voices[i];
+        if (voice->env.stage == SYNTH_ENV_IDLE) {
+            if (free_voice == NULL) {
+                free_voice = voice;
+            }
+            continue;
+        }
+        if (voice->note == note) {
+            return voice;
+        }
+        if (voice->env.stage == SYNTH_ENV_RELEASE && (released == NULL || voice->env.level < released->env.level)) {
+            released = voice;
+        }
+        if (oldest == NULL || voice->started < oldest->started) {
+            oldest = voice;
+        }
+    }
+    if (free_voice != NULL) {
+        return free_voice;
+    }
+    synth->stolen++;
+    return released != NULL ? released : oldest;
+}
+
+void synth_note_on(synth_t *synth, int note, float frequency, synth_wave_t wave, const synth_instrument_t *instrument) {
+    synth_voice_t *voice = find_voice(synth, note);
+    bool retrigger = voice->env.stage != SYNTH_ENV_IDLE;
+
+    synth_osc_t previous = voice->osc;
+    synth_osc_start(&voice->osc, wave, frequency);
+    voice->sampler.instrument = NULL;
+    if (instrument != NULL) {
+        synth_sampler_start(&voice->sampler, instrument, frequency);
+    }
+    if (retrigger) {
+        // Keep the phase so a stolen or repeated voice does not click
+        voice->osc.phase = previous.phase;
+    } else {
+        voice->env.level = 0;
+    }
+    voice->note = note;
+    voice->started = ++synth->note_counter;
+    voice->env.stage = SYNTH_ENV_ATTACK;
+    voice->env.step = (ENV_FULL - voice->env.level) / ms_to_samples(synth->adsr.attack_ms) + 1;
+}
+
+void synth_note_off(synth_t *synth, int note) {
+    for (int i = 0; i < SYNTH_VOICES; ++i) {
+        if (synth->voices[i].note == note) {
+            env_release(&synth->voices[i].env, &synth->adsr);
+        }
+    }
+}
+
+int synth_render(synth_t *synth, int16_t *out, int count) {
+    SYNTH_DSP_ALIGN int16_t mix[SYNTH_MAX_BLOCK] = { 0 };
+    SYNTH_DSP_ALIGN int16_t voice_block[SYNTH_MAX_BLOCK];
+    int sounding = 0;
+
+    for (int i = 0; i < SYNTH_VOICES; ++i) {
+        synth_voice_t *voice = &synth->voices[i];
+        if (voice->env.stage == SYNTH_ENV_IDLE) {
+            continue;
+        }
+        bool playing = true;
+        if (voice->sampler.instrument != NULL) {
+            playing = synth_sampler_render(&voice->sampler, voice_block, count, synth->voice_gain);
+        } else {
+            synth_osc_render(&voice->osc, voice_block, count, synth->voice_gain);
+        }
+        env_apply(&voice->env, &synth->adsr, voice_block, count);
+        if (!playing) {
+            // One shot sample over
+            voice->env.stage = SYNTH_ENV_IDLE;
+        }
+        synth_dsp_mix_q15(mix, voice_block, count);
+        sounding++;
+    }
+    memcpy(out, mix, count * sizeof(int16_t));
+    return sounding;
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+// Polyphonic voices: wavetable oscillators with ADSR envelopes mixed into blocks of 16 bit samples
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "sdkconfig.h"
+#include "synth_osc.h"
+#include "synth_sampler.h"
+
+#define SYNTH_VOICES CONFIG_SYNTH_PIANO_VOICES
+// Largest block synth_render() accepts
+#define SYNTH_MAX_BLOCK 256
+
+typedef struct {
+    int attack_ms;
+    int decay_ms;
+    int16_t sustain;            // Q15 level held while the note is down
+    int release_ms;
+} synth_adsr_t;
+
+typedef enum {
+    SYNTH_ENV_IDLE,
+    SYNTH_ENV_ATTACK,
+    SYNTH_ENV_DECAY,
+    SYNTH_ENV_SUSTAIN,
+    SYNTH_ENV_RELEASE,
+} synth_env_stage_t;
+
+typedef struct {
+    synth_env_stage_t stage;
+    int32_t level;              // Q30
+    int32_t step;               // added to level every sample of the current stage
+} synth_env_t;
+
+typedef struct {
+    synth_osc_t osc;
+    synth_sampler_t sampler;    // used instead of osc when sampler.instrument is set
+    synth_env_t env;
+    int note;
+    uint32_t started;           // note on counter value, lower is older
+} synth_voice_t;
+
+typedef struct {
+    synth_voice_t voices[SYNTH_VOICES];
+    synth_adsr_t adsr;
+    int16_t voice_gain;         // Q15 gain of each voice before mixing
+    uint32_t note_counter;
+    uint32_t stolen;            // voices taken from a sounding note
+} synth_t;
+
+void synth_init(synth_t *synth, const synth_adsr_t *adsr);
+
+/*
+ * Start a note with the sampled instrument, or with the wave when instrument is NULL. A voice
+ * already playing the same note is retriggered, otherwise a free voice is used, and when all
+ * are busy the quietest released voice or else the oldest one is stolen.
+ */
+void synth_note_on(synth_t *synth, int note, float frequency, synth_wave_t wave, const synth_instrument_t *instrument);
+
+/* Move every voice playing the note to its release stage */
+void synth_note_off(synth_t *synth, int note);
+
+/* Mix count (at most SYNTH_MAX_BLOCK) samples of all sounding voices, return how many sounded */
+int synth_render(synth_t *synth, int16_t *out, int count);
@@ -0,0 +1,125 @@
+#include <stdlib.h>
+#include <string.h>
+#include "wifi_ap_list.h"
+
+bool wifi_ap_list_init(wifi_ap_list_t *list, int capacity) {
+    memset(list, 0, sizeof(*list));
+    list->entries = calloc(capacity, sizeof(wifi_ap_entry_t));
+    list->capacity = list->entries ? capacity : 0;
+    return list->entries != NULL;
+}
+
+static wifi_ap_entry_t *find_entry(wifi_ap_list_t *list, const uint8_t *bssid) {
+    for (int i = 0; i < list->count; i++) {
+        if (memcmp(list->entries[i].bssid, bssid, sizeof(list->entries[i].bssid)) == 0) {
+            return &list->entries[i];
+        }
+    }
+    return NULL;
+}
+
+// Strongest first, older entries first on equal RSSI so rows do not swap back and forth
+static bool entry_before(const wifi_ap_entry_t *a, const wifi_ap_entry_t *b) {
+    return a->rssi != b->rssi ? a->rssi > b->rssi : a->id < b->id;
+}
+
+static void set_entry(wifi_ap_entry_t *entry, const wifi_ap_record_t *record, uint32_t scan) {
+    memcpy(entry->ssid, record->ssid, sizeof(entry->ssid) - 1);
+    entry->ssid[sizeof(entry->ssid) - 1] = '\0';
+    entry->rssi = record->rssi;
+    entry->channel = record->primary;
+    entry->version++;
+    entry->last_seen = scan;
+}
+
+// Weakest entry, the newest one on equal RSSI
+static wifi_ap_entry_t *weakest_entry(wifi_ap_list_t *list) {
+    wifi_ap_entry_t *weakest = &list->entries[0];
+    for (int i = 1; i < list->count; i++) {
+        if (entry_before(weakest, &list->entries[i])) {
+            weakest = &list->entries[i];
+        }
+    }
+    return weakest;
+}
+
+void wifi_ap_list_update(wifi_ap_list_t *list, const wifi_ap_record_t *records, int count) {
+    list->scan++;
+    list->added = list->removed = list->updated = list->dropped = 0;
+
+    // Update the known access points first, so those gone free their slots before new ones are added
+    for (int i = 0; i < count; i++) {
+        const wifi_ap_record_t *record = &records[i];
+        wifi_ap_entry_t *entry = find_entry(list, record->bssid);
+        if (entry == NULL || entry->last_seen == list->scan) {
+            continue;
+        }
+        if (entry->rssi != record->rssi || strncmp(entry->ssid, (const char *) record->ssid, sizeof(entry->ssid)) != 0) {
+            list->updated++;
+            set_entry(entry, record, list->scan);
+        } else {
+            entry->last_seen = list->scan;
+        }
+    }
+
+    // Drop what this scan did not see, keeping the order
+    int kept = 0;
+    for (int i = 0; i < list->count; i++) {
+        if (list->entries[i].last_seen == list->scan) {
+            if (kept != i) {
+                list->entries[kept] = list->entries[i];
+            }
+            kept++;
+        }
+    }
+    list->removed = list->count - kept;
+    list->count = kept;
+
+    // Add the new ones, when full they replace the weakest access point if stronger
+    const uint32_t last_kept_id = list->next_id;
+    for (int i = 0; i < count; i++) {
+        const wifi_ap_record_t *record = &records[i];
+        if (find_entry(list, record->bssid) != NULL) {
+            continue;
+        }
+        wifi_ap_entry_t *entry;
+        if (list->count < list->capacity) {
+            entry = &list->entries[list->count++];
+            list->added++;
+        } else {
+            entry = list->capacity > 0 ? weakest_entry(list) : NULL;
+            if (entry == NULL || entry->rssi >= record->rssi) {
+                continue;
+            }
+            if (entry->id <= last_kept_id) {
+                // Shown since an earlier scan, replaced by a new access point
+                list->removed++;
+                list->added++;
+            }
+        }
+        memcpy(entry->bssid, record->bssid, sizeof(entry->bssid));
+        entry->id = ++list->next_id;
+        entry->version = 0;
+        set_entry(entry, record, list->scan);
+    }
+    // A scan has one record per BSSID, the list now holds the ones stored
+    list->dropped = count - list->count;
+
+    // Insertion sort, the order barely changes between scans
+    for (int i = 1; i < list->count; i++) {
+        wifi_ap_entry_t entry = list->entries[i];
+        int j = i;
+        while (j > 0 && entry_before(&entry, &list->entries[j - 1])) {
+            list->entries[j] = list->entries[j - 1];
+            j--;
+        }
+        list->entries[j] = entry;
+    }
+}
+
+void wifi_ap_list_copy(wifi_ap_list_t *dst, const wifi_ap_list_t *src) {
+    wifi_ap_entry_t *entries = dst->entries;
+    memcpy(entries, src->entries, src->count * sizeof(wifi_ap_entry_t));
+    *dst = *src;
+    dst->entries = entries;
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+// Access points from consecutive scans, keyed by BSSID and kept sorted by signal strength
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_wifi_types.h"
+
+typedef struct {
+    uint8_t bssid[6];
+    char ssid[33];
+    int8_t rssi;
+    uint8_t channel;
+    uint32_t id;                // unique per appearance, identifies the entry when the order changes
+    uint32_t version;           // bumped whenever ssid or rssi change
+    uint32_t last_seen;         // scan number
+} wifi_ap_entry_t;
+
+typedef struct {
+    wifi_ap_entry_t *entries;   // strongest first
+    int count;
+    int capacity;
+    uint32_t scan;
+    uint32_t next_id;
+    // Changes made by the last wifi_ap_list_update()
+    int added;
+    int removed;
+    int updated;
+    int dropped;                // seen by the scan but not stored, the list was full of stronger ones
+} wifi_ap_list_t;
+
+bool wifi_ap_list_init(wifi_ap_list_t *list, int capacity);
+
+/*
+ * Merge the records of a finished scan: new BSSIDs are inserted, known ones updated in place
+ * when their SSID or RSSI changed, and those missing from the scan removed. When the list is
+ * full a new access point replaces the weakest one if it is stronger.
+ */
+void wifi_ap_list_update(wifi_ap_list_t *list, const wifi_ap_record_t *records, int count);
+
+/* Copy the entries and the counts of the last update from src, which has the same capacity */
+void wifi_ap_list_copy(wifi_ap_list_t *dst, const wifi_ap_list_t *src);
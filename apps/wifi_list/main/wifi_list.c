@@ -1,3 +1,4 @@
+#include <stdatomic.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/semphr.h"
@@ -9,12 +10,22 @@
 #include "esp_event.h"
 #include "nvs_flash.h"
 #include "esp_ota_ops.h"
+#include "wifi_ap_list.h"
+#include "wifi_list_view.h"
 
 #define TAG "WiFiList"
-#define DEFAULT_SCAN_LIST_SIZE 32
-
-static lv_obj_t *list;
-static bool scan_in_progress = false;
+#define MAX_APS CONFIG_WIFI_LIST_MAX_APS
+
+// Shown by the view and read while scrolling, only changed under the display lock
+static wifi_ap_list_t ap_list;
+// Scans are merged here without the display lock, then copied to ap_list
+static wifi_ap_list_t scan_list;
+// Records of the last scan, reused by every scan
+static wifi_ap_record_t scan_records[MAX_APS];
+// Processes finished scans, the event loop only notifies it
+static TaskHandle_t scan_task_handle;
+// Set by app_main when starting a scan and cleared by scan_task when it has been processed
+static atomic_bool scan_in_progress = false;
 static lv_obj_t *search_msg_box = NULL;
 
 static void list_wifi();
@@ -39,7 +50,8 @@ static void show_message(const char *text) {
 }
 
 void list_wifi() {
-    if (scan_in_progress) {
+    // Set before starting, a scan done processed first would otherwise leave it set
+    if (atomic_exchange(&scan_in_progress, true)) {
         ESP_LOGW(TAG, "Scan already in progress");
         return;
     }
@@ -56,48 +68,45 @@ void list_wifi() {
     esp_err_t err = esp_wifi_scan_start(&scan_config, false);
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "Failed to start WiFi scan: %s", esp_err_to_name(err));
-        return;
+        atomic_store(&scan_in_progress, false);
     }
-
-    scan_in_progress = true;
 }
 
 void handle_scan_done() {
     uint16_t ap_count = 0;
 
     ESP_ERROR_CHECK(esp_wifi_scan_get_ap_num(&ap_count));
-    printf("Found %d access points\n", ap_count);
-
-    wifi_ap_record_t *ap_records = (wifi_ap_record_t *)malloc(sizeof(wifi_ap_record_t) * ap_count);
-    if (ap_records == NULL) {
-        ESP_LOGE(TAG, "Failed to allocate memory for AP records");
-        scan_in_progress = false;
-        return;
-    }
+    ESP_LOGI(TAG, "Found %d access points", ap_count);
 
-    ESP_ERROR_CHECK(esp_wifi_scan_get_ap_records(&ap_count, ap_records));
-    printf("Scan done\n");
+    // Fetching fewer records than found still releases the driver's scan results
+    uint16_t record_count = MAX_APS;
+    ESP_ERROR_CHECK(esp_wifi_scan_get_ap_records(&record_count, scan_records));
+    ESP_LOGI(TAG, "Scan done");
 
-    bsp_display_lock(0);
-    // Clear the current list items
-    while (lv_obj_get_child_cnt(list) > 0) {
-        lv_obj_del(lv_obj_get_child(list, 0));
+    // Merge while rendering goes on, the display lock is only held to copy the result.
+    // Only rows in view which changed are redrawn.
+    wifi_ap_list_update(&scan_list, scan_records, record_count);
+    if (scan_list.added || scan_list.removed || scan_list.updated) {
+        bsp_display_lock(0);
+        wifi_ap_list_copy(&ap_list, &scan_list);
+        wifi_list_view_refresh();
+        bsp_display_unlock();
     }
+    ESP_LOGI(TAG, "%d access points: %d new, %d gone, %d changed, %d not fetched", scan_list.count,
+             scan_list.added, scan_list.removed, scan_list.updated, ap_count - record_count);
 
-    // Add new list items
-    for (int i = 0; i < ap_count; i++) {
-        char buffer[128];
-        snprintf(buffer, sizeof(buffer), "%s (%d)", ap_records[i].ssid, ap_records[i].rssi);
-        lv_list_add_text(list, buffer);
-    }
-    bsp_display_unlock();
-
-    free(ap_records);
-    scan_in_progress = false;
+    atomic_store(&scan_in_progress, false);
 
     close_message_box();  // Close the "Searching..." message box after scan is done
 }
 
+static void scan_task(void *arg) {
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        handle_scan_done();
+    }
+}
+
 void reset_to_factory_app() {
     // Get the partition structure for the factory partition
     const esp_partition_t *factory_partition = esp_partition_find_first(ESP_PARTITION_TYPE_APP, ESP_PARTITION_SUBTYPE_APP_FACTORY, NULL);
@@ -138,6 +147,13 @@ void app_main(void) {
     // Initialize the event loop
     ESP_ERROR_CHECK(esp_event_loop_create_default());
 
+    // Allocated once, scans only update them
+    if (!wifi_ap_list_init(&ap_list, MAX_APS) || !wifi_ap_list_init(&scan_list, MAX_APS)) {
+        ESP_LOGE(TAG, "No memory for %d access points", MAX_APS);
+        return;
+    }
+    xTaskCreate(scan_task, "scan_task", 4096, NULL, 5, &scan_task_handle);
+
     // Initialize WiFi
     wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
     ESP_ERROR_CHECK(esp_wifi_init(&cfg));
@@ -153,9 +169,10 @@ void app_main(void) {
     lv_obj_align(label, LV_ALIGN_TOP_MID, 0, 10);
 
     // Create a list for WiFi networks
-    list = lv_list_create(lv_scr_act());
+    lv_obj_t *list = wifi_list_view_create(lv_scr_act(), &ap_list);
     lv_obj_set_size(list, 300, 180);  // Adjust height to leave space for the label
     lv_obj_align(list, LV_ALIGN_CENTER, 0, 20);
+    wifi_list_view_refresh();
     bsp_display_unlock();
 
     bsp_display_backlight_on();
@@ -170,6 +187,6 @@ void app_main(void) {
 
 static void wifi_event_handler(void* arg, esp_event_base_t event_base, int32_t event_id, void* event_data) {
     if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_SCAN_DONE) {
-        handle_scan_done();
+        xTaskNotifyGive(scan_task_handle);
     }
 }
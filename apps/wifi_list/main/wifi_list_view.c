@@ -0,0 +1,101 @@
+#include <stdio.h>
+#include "wifi_list_view.h"
+
+// Rows beyond the visible ones, so a partly scrolled row at each end is covered
+#define EXTRA_ROWS 2
+#define ROW_PADDING 4
+#define MAX_ROWS 32
+
+typedef struct {
+    lv_obj_t *label;
+    int index;                  // model position shown, -1 when unused
+    uint32_t id;                // entry shown and its version, to skip unchanged text
+    uint32_t version;
+} view_row_t;
+
+static const wifi_ap_list_t *view_model;
+static lv_obj_t *view_container;
+static lv_obj_t *view_spacer;
+static view_row_t view_rows[MAX_ROWS];
+static int view_row_count;
+static int view_row_height;
+static int view_content_rows = -1;
+
+static void view_scroll_cb(lv_event_t *e) {
+    wifi_list_view_refresh();
+}
+
+lv_obj_t *wifi_list_view_create(lv_obj_t *parent, const wifi_ap_list_t *model) {
+    view_model = model;
+    view_container = lv_obj_create(parent);
+    lv_obj_set_scroll_dir(view_container, LV_DIR_VER);
+    lv_obj_add_event_cb(view_container, view_scroll_cb, LV_EVENT_SCROLL, NULL);
+
+    // Sets the scrollable height: one row per access point
+    view_spacer = lv_obj_create(view_container);
+    lv_obj_remove_style_all(view_spacer);
+    lv_obj_set_size(view_spacer, 1, 0);
+    lv_obj_clear_flag(view_spacer, LV_OBJ_FLAG_CLICKABLE);
+
+    const lv_font_t *font = lv_obj_get_style_text_font(view_container, LV_PART_MAIN);
+    view_row_height = lv_font_get_line_height(font) + 2 * ROW_PADDING;
+    return view_container;
+}
+
+// Rows are created once the final size of the container is known
+static void view_create_rows(void) {
+    lv_obj_update_layout(view_container);
+    int rows = lv_obj_get_content_height(view_container) / view_row_height + EXTRA_ROWS;
+    view_row_count = rows < MAX_ROWS ? rows : MAX_ROWS;
+    for (int i = 0; i < view_row_count; i++) {
+        view_row_t *row = &view_rows[i];
+        row->label = lv_label_create(view_container);
+        lv_obj_set_size(row->label, lv_pct(100), view_row_height);
+        lv_obj_set_style_pad_ver(row->label, ROW_PADDING, LV_PART_MAIN);
+        lv_label_set_long_mode(row->label, LV_LABEL_LONG_DOT);
+        lv_obj_add_flag(row->label, LV_OBJ_FLAG_HIDDEN);
+        row->index = -1;
+    }
+}
+
+void wifi_list_view_refresh(void) {
+    if (view_row_count == 0) {
+        view_create_rows();
+    }
+    if (view_content_rows != view_model->count) {
+        view_content_rows = view_model->count;
+        lv_obj_set_height(view_spacer, view_content_rows * view_row_height);
+    }
+
+    int first = lv_obj_get_scroll_y(view_container) / view_row_height;
+    if (first < 0) {
+        first = 0;
+    }
+    // Index i always goes to row i % view_row_count, so scrolling by a row rebinds one label
+    for (int i = first; i < first + view_row_count; i++) {
+        view_row_t *row = &view_rows[i % view_row_count];
+        if (i >= view_model->count) {
+            if (row->index != -1) {
+                lv_obj_add_flag(row->label, LV_OBJ_FLAG_HIDDEN);
+                row->index = -1;
+            }
+            continue;
+        }
+
+        const wifi_ap_entry_t *entry = &view_model->entries[i];
+        if (row->index != i) {
+            if (row->index == -1) {
+                lv_obj_clear_flag(row->label, LV_OBJ_FLAG_HIDDEN);
+            }
+            lv_obj_set_y(row->label, i * view_row_height);
+            row->index = i;
+        }
+        if (row->id != entry->id || row->version != entry->version) {
+            char buffer[64];
+            snprintf(buffer, sizeof(buffer), "%s (%d)", entry->ssid, entry->rssi);
+            lv_label_set_text(row->label, buffer);
+            row->id = entry->id;
+            row->version = entry->version;
+        }
+    }
+}
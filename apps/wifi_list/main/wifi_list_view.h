@@ -0,0 +1,12 @@
+#pragma once
+
+// Virtualized LVGL list of a wifi_ap_list_t: only the rows in view own LVGL objects
+
+#include "lvgl.h"
+#include "wifi_ap_list.h"
+
+/* Create the list view on parent, showing model. Call with the display lock held. */
+lv_obj_t *wifi_list_view_create(lv_obj_t *parent, const wifi_ap_list_t *model);
+
+/* Bring the rows in view up to date with the model after it changed. Call with the display lock held. */
+void wifi_list_view_refresh(void);
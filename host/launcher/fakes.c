@@ -0,0 +1,349 @@
+/* Host implementations of the ESP-IDF and FreeRTOS calls used by main/app_install.c */
+
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include "freertos/FreeRTOS.h"
+#include "mbedtls/sha256.h"
+
+int esp_log_level = 2;
+
+/* esp_timer / esp_system */
+
+int64_t esp_timer_get_time(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+const char *esp_err_to_name(esp_err_t code)
+{
+    return code == ESP_OK ? "ESP_OK" : "ESP_ERR";
+}
+
+void esp_restart(void)
+{
+    fprintf(stderr, "esp_restart() called\n");
+    exit(0);
+}
+
+/* heap_caps */
+
+void *heap_caps_malloc(size_t size, uint32_t caps)
+{
+    return malloc(size);
+}
+
+void heap_caps_free(void *ptr)
+{
+    free(ptr);
+}
+
+/* Partitions: the OTA slots of partitions.csv */
+
+static const esp_partition_t s_partitions[] = {
+    { ESP_PARTITION_TYPE_APP, ESP_PARTITION_SUBTYPE_APP_OTA_MIN + 0, 0x220000, 0x2c0000, 0x1000, "ota_0" },
+    { ESP_PARTITION_TYPE_APP, ESP_PARTITION_SUBTYPE_APP_OTA_MIN + 1, 0x4e0000, 0x2c0000, 0x1000, "ota_1" },
+    { ESP_PARTITION_TYPE_APP, ESP_PARTITION_SUBTYPE_APP_OTA_MIN + 2, 0x7a0000, 0x2c0000, 0x1000, "ota_2" },
+    { ESP_PARTITION_TYPE_APP, ESP_PARTITION_SUBTYPE_APP_OTA_MIN + 3, 0xa60000, 0x2c0000, 0x1000, "ota_3" },
+    { ESP_PARTITION_TYPE_APP, ESP_PARTITION_SUBTYPE_APP_OTA_MIN + 4, 0xd20000, 0x2c0000, 0x1000, "ota_4" },
+};
+
+const esp_partition_t *esp_partition_find_first(esp_partition_type_t type, esp_partition_subtype_t subtype, const char *label)
+{
+    for (size_t i = 0; i < sizeof(s_partitions) / sizeof(s_partitions[0]); i++) {
+        const esp_partition_t *partition = &s_partitions[i];
+        if (partition->type == type &&
+                (subtype == ESP_PARTITION_SUBTYPE_ANY || partition->subtype == subtype) &&
+                (label == NULL || strcmp(partition->label, label) == 0)) {
+            return partition;
+        }
+    }
+    return NULL;
+}
+
+/* OTA writes into a file per partition, one update at a time */
+
+static FILE *s_ota_file = NULL;
+static uint32_t s_ota_written = 0;
+static uint8_t s_ota_first_byte = 0;
+static const esp_partition_t *s_ota_partition = NULL;
+
+esp_err_t esp_ota_begin(const esp_partition_t *partition, size_t image_size, esp_ota_handle_t *out_handle)
+{
+    if (s_ota_file != NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    const char *dir = getenv("FAKE_FLASH_DIR");
+    char path[256];
+    snprintf(path, sizeof(path), "%s/%s.bin", dir ? dir : ".", partition->label);
+    s_ota_file = fopen(path, "wb");
+    if (s_ota_file == NULL) {
+        return ESP_FAIL;
+    }
+    s_ota_partition = partition;
+    s_ota_written = 0;
+    *out_handle = 1;
+    return ESP_OK;
+}
+
+esp_err_t esp_ota_write(esp_ota_handle_t handle, const void *data, size_t size)
+{
+    if (s_ota_file == NULL || s_ota_written + size > s_ota_partition->size) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    if (s_ota_written == 0 && size > 0) {
+        s_ota_first_byte = *(const uint8_t *) data;
+    }
+    s_ota_written += size;
+    return fwrite(data, 1, size, s_ota_file) == size ? ESP_OK : ESP_FAIL;
+}
+
+esp_err_t esp_ota_abort(esp_ota_handle_t handle)
+{
+    if (s_ota_file) {
+        fclose(s_ota_file);
+        s_ota_file = NULL;
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_ota_end(esp_ota_handle_t handle)
+{
+    esp_ota_abort(handle);
+    // The real one verifies the whole image, the magic byte is enough here
+    return s_ota_first_byte == 0xe9 ? ESP_OK : ESP_ERR_OTA_VALIDATE_FAILED;
+}
+
+/* SHA-256 (FIPS 180-4) */
+
+static const uint32_t s_sha256_k[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+#define SHA256_ROTR(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+static void sha256_block(mbedtls_sha256_context *ctx, const uint8_t *block)
+{
+    uint32_t w[64];
+    for (int i = 0; i < 16; i++) {
+        w[i] = (uint32_t) block[i * 4] << 24 | (uint32_t) block[i * 4 + 1] << 16 |
+               (uint32_t) block[i * 4 + 2] << 8 | block[i * 4 + 3];
+    }
+    for (int i = 16; i < 64; i++) {
+        uint32_t s0 = SHA256_ROTR(w[i - 15], 7) ^ SHA256_ROTR(w[i - 15], 18) ^ (w[i - 15] >> 3);
+        uint32_t s1 = SHA256_ROTR(w[i - 2], 17) ^ SHA256_ROTR(w[i - 2], 19) ^ (w[i - 2] >> 10);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+
+    uint32_t v[8];
+    memcpy(v, ctx->state, sizeof(v));
+    for (int i = 0; i < 64; i++) {
+        uint32_t s1 = SHA256_ROTR(v[4], 6) ^ SHA256_ROTR(v[4], 11) ^ SHA256_ROTR(v[4], 25);
+        uint32_t ch = (v[4] & v[5]) ^ (~v[4] & v[6]);
+        uint32_t t1 = v[7] + s1 + ch + s_sha256_k[i] + w[i];
+        uint32_t s0 = SHA256_ROTR(v[0], 2) ^ SHA256_ROTR(v[0], 13) ^ SHA256_ROTR(v[0], 22);
+        uint32_t maj = (v[0] & v[1]) ^ (v[0] & v[2]) ^ (v[1] & v[2]);
+        memmove(&v[1], &v[0], 7 * sizeof(v[0]));
+        v[4] += t1;
+        v[0] = t1 + s0 + maj;
+    }
+    for (int i = 0; i < 8; i++) {
+        ctx->state[i] += v[i];
+    }
+}
+
+void mbedtls_sha256_init(mbedtls_sha256_context *ctx)
+{
+    memset(ctx, 0, sizeof(*ctx));
+}
+
+void mbedtls_sha256_free(mbedtls_sha256_context *ctx)
+{
+}
+
+int mbedtls_sha256_starts(mbedtls_sha256_context *ctx, int is224)
+{
+    static const uint32_t init[8] = {
+        0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+    };
+    memcpy(ctx->state, init, sizeof(init));
+    ctx->length = 0;
+    ctx->buffered = 0;
+    return 0;
+}
+
+int mbedtls_sha256_update(mbedtls_sha256_context *ctx, const unsigned char *input, size_t ilen)
+{
+    ctx->length += ilen;
+    while (ilen > 0) {
+        size_t n = sizeof(ctx->buffer) - ctx->buffered;
+        if (n > ilen) {
+            n = ilen;
+        }
+        memcpy(ctx->buffer + ctx->buffered, input, n);
+        ctx->buffered += n;
+        input += n;
+        ilen -= n;
+        if (ctx->buffered == sizeof(ctx->buffer)) {
+            sha256_block(ctx, ctx->buffer);
+            ctx->buffered = 0;
+        }
+    }
+    return 0;
+}
+
+int mbedtls_sha256_finish(mbedtls_sha256_context *ctx, unsigned char output[32])
+{
+    uint64_t bits = ctx->length * 8;
+    uint8_t pad[72] = { 0x80 };
+    size_t pad_len = (ctx->buffered < 56 ? 56 : 120) - ctx->buffered;
+    for (int i = 0; i < 8; i++) {
+        pad[pad_len + i] = (uint8_t) (bits >> (56 - i * 8));
+    }
+    mbedtls_sha256_update(ctx, pad, pad_len + 8);
+    for (int i = 0; i < 8; i++) {
+        output[i * 4] = (uint8_t) (ctx->state[i] >> 24);
+        output[i * 4 + 1] = (uint8_t) (ctx->state[i] >> 16);
+        output[i * 4 + 2] = (uint8_t) (ctx->state[i] >> 8);
+        output[i * 4 + 3] = (uint8_t) ctx->state[i];
+    }
+    return 0;
+}
+
+/* FreeRTOS tasks and queues */
+
+struct fake_task {
+    pthread_t thread;
+    TaskFunction_t fn;
+    void *param;
+};
+
+struct fake_queue {
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    size_t item_size;
+    size_t length;
+    size_t head;
+    size_t count;
+    uint8_t items[];
+};
+
+static void *fake_task_entry(void *arg)
+{
+    struct fake_task *task = arg;
+    task->fn(task->param);
+    return NULL;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t fn, const char *name, uint32_t stack_depth, void *param,
+                       UBaseType_t priority, TaskHandle_t *created_task)
+{
+    struct fake_task *task = calloc(1, sizeof(*task));
+    task->fn = fn;
+    task->param = param;
+    if (pthread_create(&task->thread, NULL, fake_task_entry, task) != 0) {
+        free(task);
+        return pdFAIL;
+    }
+    pthread_detach(task->thread);
+    if (created_task) {
+        *created_task = task;
+    }
+    return pdPASS;
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+    usleep(ticks * 1000);
+}
+
+void vTaskDelete(TaskHandle_t task)
+{
+    if (task == NULL) {
+        pthread_exit(NULL);
+    }
+}
+
+UBaseType_t uxTaskPriorityGet(TaskHandle_t task)
+{
+    return tskIDLE_PRIORITY + 1;
+}
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size)
+{
+    struct fake_queue *queue = calloc(1, sizeof(*queue) + length * item_size);
+    pthread_mutex_init(&queue->lock, NULL);
+    pthread_cond_init(&queue->changed, NULL);
+    queue->item_size = item_size;
+    queue->length = length;
+    return queue;
+}
+
+void vQueueDelete(QueueHandle_t queue)
+{
+    pthread_mutex_destroy(&queue->lock);
+    pthread_cond_destroy(&queue->changed);
+    free(queue);
+}
+
+/* Wait for an item (or a free slot), false on timeout. Called with the queue locked. */
+static bool fake_queue_wait(QueueHandle_t queue, bool want_items, TickType_t ticks)
+{
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += ticks / 1000;
+    deadline.tv_nsec += (long) (ticks % 1000) * 1000000;
+    if (deadline.tv_nsec >= 1000000000) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000;
+    }
+
+    while (want_items ? queue->count == 0 : queue->count == queue->length) {
+        if (ticks == 0) {
+            return false;
+        }
+        if (ticks == portMAX_DELAY) {
+            pthread_cond_wait(&queue->changed, &queue->lock);
+        } else if (pthread_cond_timedwait(&queue->changed, &queue->lock, &deadline) != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t ticks_to_wait)
+{
+    pthread_mutex_lock(&queue->lock);
+    bool ok = fake_queue_wait(queue, false, ticks_to_wait);
+    if (ok) {
+        size_t tail = (queue->head + queue->count) % queue->length;
+        memcpy(queue->items + tail * queue->item_size, item, queue->item_size);
+        queue->count++;
+        pthread_cond_broadcast(&queue->changed);
+    }
+    pthread_mutex_unlock(&queue->lock);
+    return ok ? pdTRUE : pdFALSE;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void *buffer, TickType_t ticks_to_wait)
+{
+    pthread_mutex_lock(&queue->lock);
+    bool ok = fake_queue_wait(queue, true, ticks_to_wait);
+    if (ok) {
+        memcpy(buffer, queue->items + queue->head * queue->item_size, queue->item_size);
+        queue->head = (queue->head + 1) % queue->length;
+        queue->count--;
+        pthread_cond_broadcast(&queue->changed);
+    }
+    pthread_mutex_unlock(&queue->lock);
+    return ok ? pdTRUE : pdFALSE;
+}
@@ -0,0 +1,80 @@
+/* Install a package made by tools/pack_app.py into a file backed OTA slot and compare
+ * the result with the original image */
+
+#include <getopt.h>
+#include <inttypes.h>
+#include "app_install.h"
+
+static uint8_t *bench_read_file(const char *path, size_t *size)
+{
+    FILE *f = fopen(path, "rb");
+    if (f == NULL) {
+        return NULL;
+    }
+    fseek(f, 0, SEEK_END);
+    *size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    uint8_t *data = malloc(*size ? *size : 1);
+    if (fread(data, 1, *size, f) != *size) {
+        free(data);
+        data = NULL;
+    }
+    fclose(f);
+    return data;
+}
+
+int main(int argc, char **argv)
+{
+    int opt;
+    while ((opt = getopt(argc, argv, "v")) != -1) {
+        switch (opt) {
+        case 'v':
+            esp_log_level = 4;
+            break;
+        default:
+            goto usage;
+        }
+    }
+    if (argc - optind != 2) {
+        goto usage;
+    }
+    const char *package = argv[optind];
+    const char *image_path = argv[optind + 1];
+
+    app_install_stats_t stats;
+    esp_err_t ret = app_install_from_file(package, &stats);
+    if (ret != ESP_OK) {
+        fprintf(stderr, "install failed: 0x%x\n", ret);
+        return 1;
+    }
+
+    app_package_header_t header;
+    FILE *f = fopen(package, "rb");
+    if (f == NULL || fread(&header, sizeof(header), 1, f) != 1) {
+        return 1;
+    }
+    fclose(f);
+
+    const char *dir = getenv("FAKE_FLASH_DIR");
+    char slot_path[256];
+    snprintf(slot_path, sizeof(slot_path), "%s/ota_%u.bin", dir ? dir : ".", header.slot);
+    size_t image_size, slot_size;
+    uint8_t *image = bench_read_file(image_path, &image_size);
+    uint8_t *slot = bench_read_file(slot_path, &slot_size);
+    if (image == NULL || slot == NULL || image_size != slot_size || memcmp(image, slot, image_size) != 0) {
+        fprintf(stderr, "%s does not match %s\n", slot_path, image_path);
+        return 1;
+    }
+
+    printf("%-10s %10s %10s %10s %10s %10s\n", "slot", "package", "image", "total ms", "write ms", "MB/s");
+    printf("ota_%-6u %10" PRIu32 " %10" PRIu32 " %10.1f %10.1f %10.1f\n", header.slot,
+           stats.package_bytes, stats.image_bytes, stats.total_us / 1000.0, stats.write_us / 1000.0,
+           stats.total_us ? (double) stats.image_bytes / stats.total_us : 0.0);
+    free(image);
+    free(slot);
+    return 0;
+
+usage:
+    fprintf(stderr, "usage: %s [-v] package.gblz image.bin\n", argv[0]);
+    return 1;
+}
@@ -0,0 +1,293 @@
+/* Life engine benchmark and correctness check.
+ *
+ * Every workload (the known patterns and random soups of several densities) is run on
+ * square worlds of several sizes with the dense engine (life_engine.c) and the sparse
+ * world (life_world.c). Both are first compared cell by cell with life_reference.c for
+ * a number of generations, then timed from a fresh seed. The exit status is 1 when any
+ * engine disagrees with the reference. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include "life_engine.h"
+#include "life_world.h"
+#include "life_patterns.h"
+#include "life_reference.h"
+
+#define BENCH_MAX_SIZES 8
+// Timed cell updates per engine and workload, generations are derived from it
+#define BENCH_CELL_GENERATIONS 100000000.0
+
+typedef struct {
+    const char *name;
+    const life_pattern_t *pattern;  // NULL for a random soup
+    int density;                    // soup density in 1/256
+} bench_workload_t;
+
+typedef struct {
+    const char *name;
+    void *(*create)(int size);
+    void (*destroy)(void *engine);
+    void (*set)(void *engine, int x, int y);
+    bool (*get)(void *engine, int x, int y);
+    void (*step)(void *engine);
+} bench_engine_t;
+
+static uint32_t bench_random_state;
+
+/* xorshift32, so every engine gets the same soup */
+static uint32_t bench_random(void)
+{
+    uint32_t x = bench_random_state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    bench_random_state = x;
+    return x;
+}
+
+static double bench_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void *dense_create(int size)
+{
+    life_grid_t *grid = malloc(sizeof(*grid));
+    if (grid != NULL && !life_grid_init(grid, size, size)) {
+        free(grid);
+        return NULL;
+    }
+    return grid;
+}
+
+static void dense_destroy(void *engine)
+{
+    life_grid_free(engine);
+    free(engine);
+}
+
+static void dense_set(void *engine, int x, int y)
+{
+    life_grid_set(engine, x, y, true);
+}
+
+static bool dense_get(void *engine, int x, int y)
+{
+    return life_grid_get(engine, x, y);
+}
+
+static void dense_step(void *engine)
+{
+    life_grid_step(engine);
+}
+
+static void *sparse_create(int size)
+{
+    life_world_t *world = malloc(sizeof(*world));
+    if (world != NULL && !life_world_init(world, size, size)) {
+        free(world);
+        return NULL;
+    }
+    return world;
+}
+
+static void sparse_destroy(void *engine)
+{
+    life_world_free(engine);
+    free(engine);
+}
+
+static void sparse_set(void *engine, int x, int y)
+{
+    life_world_set(engine, x, y, true);
+}
+
+static bool sparse_get(void *engine, int x, int y)
+{
+    return life_world_get(engine, x, y);
+}
+
+static void sparse_step(void *engine)
+{
+    life_world_step(engine);
+}
+
+static const bench_engine_t bench_engines[] = {
+    { "dense", dense_create, dense_destroy, dense_set, dense_get, dense_step },
+    { "sparse", sparse_create, sparse_destroy, sparse_set, sparse_get, sparse_step },
+};
+
+typedef struct {
+    const bench_engine_t *engine;
+    void *state;
+    int size;
+} bench_seed_ctx_t;
+
+static void bench_seed_set(void *ctx, int x, int y)
+{
+    bench_seed_ctx_t *seed = ctx;
+    seed->engine->set(seed->state, x % seed->size, y % seed->size);
+}
+
+/* Patterns go in the middle, soups fill the whole world */
+static void bench_seed(const bench_workload_t *workload, const bench_engine_t *engine, void *state, int size)
+{
+    bench_seed_ctx_t ctx = { engine, state, size };
+    if (workload->pattern != NULL) {
+        life_pattern_place(workload->pattern, size / 2 - workload->pattern->width / 2,
+                           size / 2 - workload->pattern->height / 2, bench_seed_set, &ctx);
+        return;
+    }
+    bench_random_state = 1;
+    for (int y = 0; y < size; y++) {
+        for (int x = 0; x < size; x++) {
+            if ((int) (bench_random() & 0xff) < workload->density) {
+                engine->set(state, x, y);
+            }
+        }
+    }
+}
+
+static bool bench_matches(const bench_engine_t *engine, void *state, const life_reference_t *ref)
+{
+    for (int y = 0; y < ref->height; y++) {
+        for (int x = 0; x < ref->width; x++) {
+            if (engine->get(state, x, y) != life_reference_get(ref, x, y)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+/* Step the engine alongside the reference, return the first mismatching generation or -1 */
+static int bench_verify(const bench_workload_t *workload, const bench_engine_t *engine, int size, int generations)
+{
+    void *state = engine->create(size);
+    life_reference_t ref;
+    if (state == NULL || !life_reference_init(&ref, size, size)) {
+        fprintf(stderr, "no memory for a %dx%d world\n", size, size);
+        exit(1);
+    }
+    bench_seed(workload, engine, state, size);
+    for (int y = 0; y < size; y++) {
+        for (int x = 0; x < size; x++) {
+            life_reference_set(&ref, x, y, engine->get(state, x, y));
+        }
+    }
+
+    int mismatch = -1;
+    for (int generation = 1; generation <= generations; generation++) {
+        engine->step(state);
+        life_reference_step(&ref);
+        if (!bench_matches(engine, state, &ref)) {
+            mismatch = generation;
+            break;
+        }
+    }
+    life_reference_free(&ref);
+    engine->destroy(state);
+    return mismatch;
+}
+
+/* Nanoseconds per cell and generation */
+static double bench_time(const bench_workload_t *workload, const bench_engine_t *engine, int size, int generations)
+{
+    void *state = engine->create(size);
+    if (state == NULL) {
+        fprintf(stderr, "no memory for a %dx%d world\n", size, size);
+        exit(1);
+    }
+    bench_seed(workload, engine, state, size);
+    double start = bench_now();
+    for (int i = 0; i < generations; i++) {
+        engine->step(state);
+    }
+    double elapsed = bench_now() - start;
+    engine->destroy(state);
+    return elapsed * 1e9 / ((double) size * size * generations);
+}
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr, "usage: %s [-s size,size,...] [-v verified generations, 0 to skip] [-w workload]\n", argv0);
+    exit(2);
+}
+
+int main(int argc, char **argv)
+{
+    int sizes[BENCH_MAX_SIZES] = { 128, 512, 2048 };
+    int size_count = 3;
+    int verify_generations = 100;
+    const char *only = NULL;
+    int opt;
+    while ((opt = getopt(argc, argv, "s:v:w:")) != -1) {
+        switch (opt) {
+        case 's':
+            size_count = 0;
+            for (char *item = strtok(optarg, ","); item != NULL && size_count < BENCH_MAX_SIZES; item = strtok(NULL, ",")) {
+                sizes[size_count] = atoi(item) / LIFE_WORD_BITS * LIFE_WORD_BITS;
+                if (sizes[size_count] == 0) {
+                    usage(argv[0]);
+                }
+                size_count++;
+            }
+            break;
+        case 'v':
+            verify_generations = atoi(optarg);
+            break;
+        case 'w':
+            only = optarg;
+            break;
+        default:
+            usage(argv[0]);
+        }
+    }
+
+    bench_workload_t workloads[16];
+    int workload_count = 0;
+    for (size_t i = 0; i < life_pattern_count; i++) {
+        workloads[workload_count++] = (bench_workload_t) { life_patterns[i].name, &life_patterns[i], 0 };
+    }
+    workloads[workload_count++] = (bench_workload_t) { "soup-12%", NULL, 32 };
+    workloads[workload_count++] = (bench_workload_t) { "soup-37%", NULL, 96 };
+    workloads[workload_count++] = (bench_workload_t) { "soup-62%", NULL, 160 };
+
+    bool failed = false;
+    printf("%-12s %6s  %-7s %10s %12s  %s\n", "workload", "size", "engine", "ns/cell", "gen/s", "reference");
+    for (int w = 0; w < workload_count; w++) {
+        if (only != NULL && strcmp(only, workloads[w].name) != 0) {
+            continue;
+        }
+        for (int s = 0; s < size_count; s++) {
+            int size = sizes[s];
+            int generations = (int) (BENCH_CELL_GENERATIONS / ((double) size * size));
+            if (generations < 10) {
+                generations = 10;
+            }
+            for (size_t e = 0; e < sizeof(bench_engines) / sizeof(bench_engines[0]); e++) {
+                const bench_engine_t *engine = &bench_engines[e];
+                char verdict[32] = "skipped";
+                if (verify_generations > 0) {
+                    int mismatch = bench_verify(&workloads[w], engine, size, verify_generations);
+                    if (mismatch < 0) {
+                        snprintf(verdict, sizeof(verdict), "ok (%d gens)", verify_generations);
+                    } else {
+                        snprintf(verdict, sizeof(verdict), "MISMATCH at gen %d", mismatch);
+                        failed = true;
+                    }
+                }
+                double ns = bench_time(&workloads[w], engine, size, generations);
+                printf("%-12s %6d  %-7s %10.4f %12.1f  %s\n", workloads[w].name, size, engine->name, ns,
+                       1e9 / (ns * size * size), verdict);
+            }
+        }
+    }
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,43 @@
+#include <stdlib.h>
+#include "life_reference.h"
+
+bool life_reference_init(life_reference_t *ref, int width, int height)
+{
+    ref->width = width;
+    ref->height = height;
+    ref->cells = calloc(width, height);
+    ref->next = calloc(width, height);
+    if (ref->cells == NULL || ref->next == NULL) {
+        life_reference_free(ref);
+        return false;
+    }
+    return true;
+}
+
+void life_reference_free(life_reference_t *ref)
+{
+    free(ref->cells);
+    free(ref->next);
+    ref->cells = NULL;
+    ref->next = NULL;
+}
+
+void life_reference_step(life_reference_t *ref)
+{
+    const int w = ref->width;
+    const int h = ref->height;
+    for (int y = 0; y < h; y++) {
+        const uint8_t *up = &ref->cells[((y + h - 1) % h) * w];
+        const uint8_t *mid = &ref->cells[y * w];
+        const uint8_t *down = &ref->cells[((y + 1) % h) * w];
+        for (int x = 0; x < w; x++) {
+            int west = (x + w - 1) % w;
+            int east = (x + 1) % w;
+            int count = up[west] + up[x] + up[east] + mid[west] + mid[east] + down[west] + down[x] + down[east];
+            ref->next[y * w + x] = count == 3 || (count == 2 && mid[x]);
+        }
+    }
+    uint8_t *cells = ref->cells;
+    ref->cells = ref->next;
+    ref->next = cells;
+}
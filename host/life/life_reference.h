@@ -0,0 +1,27 @@
+#pragma once
+
+/* Straightforward one byte per cell Life on a torus, the yardstick for the engines */
+
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef struct {
+    int width;
+    int height;
+    uint8_t *cells;
+    uint8_t *next;
+} life_reference_t;
+
+bool life_reference_init(life_reference_t *ref, int width, int height);
+void life_reference_free(life_reference_t *ref);
+void life_reference_step(life_reference_t *ref);
+
+static inline bool life_reference_get(const life_reference_t *ref, int x, int y)
+{
+    return ref->cells[y * ref->width + x];
+}
+
+static inline void life_reference_set(life_reference_t *ref, int x, int y, bool alive)
+{
+    ref->cells[y * ref->width + x] = alive;
+}
@@ -0,0 +1,150 @@
+/* Check that the mix and gain kernels give the same result on their esp-dsp path as on
+ * their loops, at and around the INT16 extremes: saturation for the mix, truncation of the
+ * product for the gain.
+ *
+ * synth_dsp.c is built as on the ESP32-S3 with esp-dsp, against the models in stubs/.
+ * Aligned blocks of SYNTH_DSP_VECTOR samples go through the modelled dsps_add_s16() and
+ * dsps_mulc_s16(), the same data one sample off alignment through the loops. The models
+ * abort on arguments the esp-dsp versions cannot take. The exit status is 1 when any
+ * check fails. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "synth_dsp.h"
+
+#define CHECK_SAMPLES 256
+
+static int failures;
+
+int dsps_add_s16(const int16_t *input1, const int16_t *input2, int16_t *output, int len,
+                 int step1, int step2, int step_out, int shift)
+{
+    if (len % 8 || ((uintptr_t) input1 | (uintptr_t) input2 | (uintptr_t) output) % 16 ||
+            step1 != 1 || step2 != 1 || step_out != 1 || shift != 0) {
+        fprintf(stderr, "dsps_add_s16: arguments the PIE version does not take\n");
+        abort();
+    }
+    for (int i = 0; i < len; i++) {
+        int32_t sum = input1[i] + input2[i];
+        output[i] = (int16_t) (sum > INT16_MAX ? INT16_MAX : sum < INT16_MIN ? INT16_MIN : sum);
+    }
+    return 0;
+}
+
+int dsps_mulc_s16(const int16_t *input, int16_t *output, int len, int16_t C, int step_in, int step_out)
+{
+    if (step_in != 1 || step_out != 1) {
+        fprintf(stderr, "dsps_mulc_s16: unexpected steps\n");
+        abort();
+    }
+    for (int i = 0; i < len; i++) {
+        output[i * step_out] = (int16_t) ((input[i * step_in] * C) >> 15);
+    }
+    return 0;
+}
+
+static const int16_t extremes[] = {
+    INT16_MIN, INT16_MIN + 1, -16384, -1, 0, 1, 16384, INT16_MAX - 1, INT16_MAX,
+};
+
+#define EXTREME_COUNT (int) (sizeof(extremes) / sizeof(extremes[0]))
+
+static void check_mix(void)
+{
+    static SYNTH_DSP_ALIGN int16_t vec_acc[CHECK_SAMPLES];
+    static SYNTH_DSP_ALIGN int16_t vec_in[CHECK_SAMPLES];
+    // One sample past 16 byte alignment, so the kernel takes the loop
+    static SYNTH_DSP_ALIGN int16_t loop_acc[CHECK_SAMPLES + 1];
+    static SYNTH_DSP_ALIGN int16_t loop_in[CHECK_SAMPLES + 1];
+
+    // Every pair of extremes, then random values pushed towards them
+    int pairs = EXTREME_COUNT * EXTREME_COUNT;
+    for (int i = 0; i < CHECK_SAMPLES; i++) {
+        if (i < pairs) {
+            vec_acc[i] = extremes[i / EXTREME_COUNT];
+            vec_in[i] = extremes[i % EXTREME_COUNT];
+        } else {
+            vec_acc[i] = (int16_t) (rand() % 2 ? INT16_MAX - rand() % 256 : INT16_MIN + rand() % 256);
+            vec_in[i] = (int16_t) (rand() % 65536 - 32768);
+        }
+    }
+    memcpy(loop_acc + 1, vec_acc, sizeof(vec_acc));
+    memcpy(loop_in + 1, vec_in, sizeof(vec_in));
+
+    for (int i = 0; i < CHECK_SAMPLES; i++) {
+        int32_t sum = vec_acc[i] + vec_in[i];
+        int16_t expected = (int16_t) (sum > INT16_MAX ? INT16_MAX : sum < INT16_MIN ? INT16_MIN : sum);
+        int16_t acc = vec_acc[i];
+        synth_dsp_mix_q15(&acc, &vec_in[i], 1);
+        if (acc != expected) {
+            printf("FAIL loop: %d + %d = %d, expected %d\n", vec_acc[i], vec_in[i], acc, expected);
+            failures++;
+        }
+    }
+
+    synth_dsp_mix_q15(vec_acc, vec_in, CHECK_SAMPLES);
+    synth_dsp_mix_q15(loop_acc + 1, loop_in + 1, CHECK_SAMPLES);
+    for (int i = 0; i < CHECK_SAMPLES; i++) {
+        if (vec_acc[i] != loop_acc[i + 1]) {
+            printf("FAIL sample %d: vector %d, loop %d\n", i, vec_acc[i], loop_acc[i + 1]);
+            failures++;
+        }
+    }
+
+}
+
+static void check_gain(void)
+{
+    static SYNTH_DSP_ALIGN int16_t vec_buf[CHECK_SAMPLES];
+    static SYNTH_DSP_ALIGN int16_t loop_buf[CHECK_SAMPLES + 1];
+    static int16_t samples[CHECK_SAMPLES];
+
+    // Truncation rounds towards minus infinity, the one product too large wraps
+    const struct {
+        int16_t sample, gain, expected;
+    } cases[] = {
+        { -1, 1, -1 },
+        { 1, 1, 0 },
+        { 16384, 16384, 8192 },
+        { INT16_MAX, INT16_MAX, INT16_MAX - 1 },
+        { INT16_MIN, INT16_MAX, INT16_MIN + 1 },
+        { INT16_MIN, INT16_MIN, INT16_MIN },
+    };
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        int16_t sample = cases[i].sample;
+        synth_dsp_gain_q15(&sample, 1, cases[i].gain);
+        if (sample != cases[i].expected) {
+            printf("FAIL gain loop: %d * %d = %d, expected %d\n", cases[i].sample, cases[i].gain,
+                   sample, cases[i].expected);
+            failures++;
+        }
+    }
+
+    for (int i = 0; i < CHECK_SAMPLES; i++) {
+        samples[i] = i < EXTREME_COUNT ? extremes[i] : (int16_t) (rand() % 65536 - 32768);
+    }
+    for (int g = 0; g < EXTREME_COUNT; g++) {
+        memcpy(vec_buf, samples, sizeof(samples));
+        memcpy(loop_buf + 1, samples, sizeof(samples));
+        synth_dsp_gain_q15(vec_buf, CHECK_SAMPLES, extremes[g]);
+        synth_dsp_gain_q15(loop_buf + 1, CHECK_SAMPLES, extremes[g]);
+        for (int i = 0; i < CHECK_SAMPLES; i++) {
+            int16_t expected = (int16_t) ((samples[i] * extremes[g]) >> 15);
+            if (vec_buf[i] != loop_buf[i + 1] || vec_buf[i] != expected) {
+                printf("FAIL gain %d, sample %d: vector %d, loop %d, expected %d\n", extremes[g],
+                       samples[i], vec_buf[i], loop_buf[i + 1], expected);
+                failures++;
+            }
+        }
+    }
+}
+
+int main(void)
+{
+    srand(1);
+    check_mix();
+    check_gain();
+    printf("mix and gain (%s): %s\n", synth_dsp_backend(), failures ? "FAILED" : "OK");
+    return failures ? 1 : 0;
+}
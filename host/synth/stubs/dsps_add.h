@@ -0,0 +1,11 @@
+#pragma once
+
+/* Host model of the esp-dsp PIE add for dsp_check: ee.vadds.s16 adds eight lanes with
+ * saturation, on 16 byte aligned buffers. Implemented in dsp_check.c. */
+
+#include <stdint.h>
+
+#define dsps_add_s16_aes3_enabled 1
+
+int dsps_add_s16(const int16_t *input1, const int16_t *input2, int16_t *output, int len,
+                 int step1, int step2, int step_out, int shift);
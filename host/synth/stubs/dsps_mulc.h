@@ -0,0 +1,10 @@
+#pragma once
+
+/* Host model of the esp-dsp multiply by a Q15 constant for dsp_check: the product shifted
+ * right by 15 and truncated to 16 bits. Implemented in dsp_check.c. */
+
+#include <stdint.h>
+
+#define dsps_mulc_s16_ae32_enabled 1
+
+int dsps_mulc_s16(const int16_t *input, int16_t *output, int len, int16_t C, int step_in, int step_out);
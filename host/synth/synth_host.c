@@ -0,0 +1,41 @@
+/* Run the synth kernel benchmark on the host. Cycles are derived from the wall clock at
+ * the given core clock, so compare them between kernel versions on the same machine. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <getopt.h>
+#include "synth_bench.h"
+
+static uint64_t host_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+int main(int argc, char **argv)
+{
+    double mhz = 3000;
+    int block_size = 224;
+    int opt;
+    while ((opt = getopt(argc, argv, "m:b:")) != -1) {
+        switch (opt) {
+        case 'm':
+            mhz = atof(optarg);
+            break;
+        case 'b':
+            block_size = atoi(optarg);
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-m cpu MHz] [-b block size]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (mhz <= 0 || block_size <= 0) {
+        return 2;
+    }
+    printf("Host core clock taken as %.0f MHz\n", mhz);
+    synth_bench_run(host_now, 1e9, mhz * 1e6, block_size);
+    return 0;
+}
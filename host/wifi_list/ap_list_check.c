@@ -0,0 +1,193 @@
+/* Check of the Wi-Fi access point list.
+ *
+ * A few fixed scan sequences check the change counters, then random scans with access
+ * points coming, going and changing strength check that the list always holds the
+ * strongest access points of the last scan, strongest first. The exit status is 1 when
+ * any check fails. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include "wifi_ap_list.h"
+
+#define MAX_RECORDS 64
+
+static int failures;
+
+#define CHECK(cond, ...)                        \
+    do {                                        \
+        if (!(cond)) {                          \
+            printf("FAIL %s: ", __func__);      \
+            printf(__VA_ARGS__);                \
+            printf("\n");                       \
+            failures++;                         \
+        }                                       \
+    } while (0)
+
+/* Access point n, its BSSID and SSID are derived from n */
+static wifi_ap_record_t ap(int n, int rssi)
+{
+    wifi_ap_record_t record = { 0 };
+    record.bssid[0] = 0x02;
+    record.bssid[4] = (uint8_t) (n >> 8);
+    record.bssid[5] = (uint8_t) n;
+    snprintf((char *) record.ssid, sizeof(record.ssid), "ap-%d", n);
+    record.primary = 1 + n % 13;
+    record.rssi = (int8_t) rssi;
+    return record;
+}
+
+static int ap_number(const wifi_ap_entry_t *entry)
+{
+    return entry->bssid[4] << 8 | entry->bssid[5];
+}
+
+static void check_counts(const char *step, const wifi_ap_list_t *list,
+                         int count, int added, int removed, int updated, int dropped)
+{
+    CHECK(list->count == count && list->added == added && list->removed == removed &&
+          list->updated == updated && list->dropped == dropped,
+          "%s: count=%d added=%d removed=%d updated=%d dropped=%d, expected %d %d %d %d %d", step,
+          list->count, list->added, list->removed, list->updated, list->dropped,
+          count, added, removed, updated, dropped);
+}
+
+static void check_fixed(void)
+{
+    wifi_ap_list_t list;
+    wifi_ap_record_t scan[8];
+    if (!wifi_ap_list_init(&list, 4)) {
+        CHECK(0, "no memory");
+        return;
+    }
+
+    for (int i = 0; i < 4; i++) {
+        scan[i] = ap(i, -40 - i);
+    }
+    wifi_ap_list_update(&list, scan, 4);
+    check_counts("first scan", &list, 4, 4, 0, 0, 0);
+    wifi_ap_list_update(&list, scan, 4);
+    check_counts("same scan", &list, 4, 0, 0, 0, 0);
+
+    // A full list of access points all gone, replaced by as many new ones
+    for (int i = 0; i < 4; i++) {
+        scan[i] = ap(10 + i, -60 - i);
+    }
+    wifi_ap_list_update(&list, scan, 4);
+    check_counts("all replaced", &list, 4, 4, 4, 0, 0);
+
+    // One gets stronger and moves to the top
+    scan[3].rssi = -30;
+    wifi_ap_list_update(&list, scan, 4);
+    check_counts("stronger", &list, 4, 0, 0, 1, 0);
+    CHECK(ap_number(&list.entries[0]) == 13, "strongest is ap-%d, expected ap-13", ap_number(&list.entries[0]));
+
+    // Two more found, stronger than two of the known ones which give way
+    scan[4] = ap(20, -50);
+    scan[5] = ap(21, -55);
+    wifi_ap_list_update(&list, scan, 6);
+    check_counts("full, stronger new", &list, 4, 2, 2, 0, 2);
+
+    // Two more found, weaker than all known ones
+    scan[4] = ap(20, -50);
+    scan[5] = ap(21, -55);
+    scan[6] = ap(30, -90);
+    scan[7] = ap(31, -91);
+    wifi_ap_list_update(&list, scan, 8);
+    check_counts("full, weaker new", &list, 4, 0, 0, 0, 4);
+
+    wifi_ap_list_update(&list, scan, 0);
+    check_counts("empty scan", &list, 0, 0, 4, 0, 0);
+    free(list.entries);
+}
+
+static int record_before(const void *a, const void *b)
+{
+    return ((const wifi_ap_record_t *) b)->rssi - ((const wifi_ap_record_t *) a)->rssi;
+}
+
+/* Random scans out of a population of access points, all with different strength so the
+ * expected list is unique: the strongest records of the scan up to the capacity */
+static void check_random(int scans, int capacity)
+{
+    wifi_ap_list_t list;
+    wifi_ap_list_t shown;
+    wifi_ap_record_t scan[MAX_RECORDS];
+    wifi_ap_record_t expected[MAX_RECORDS];
+    if (!wifi_ap_list_init(&list, capacity) || !wifi_ap_list_init(&shown, capacity)) {
+        CHECK(0, "no memory");
+        return;
+    }
+
+    for (int s = 0; s < scans && failures == 0; s++) {
+        // Each of 100 possible access points is in the scan with a chance of 1/3,
+        // its strength taken from a shuffled set of distinct values
+        int rssi[100];
+        for (int i = 0; i < 100; i++) {
+            rssi[i] = -10 - i;
+        }
+        for (int i = 99; i > 0; i--) {
+            int j = rand() % (i + 1);
+            int tmp = rssi[i];
+            rssi[i] = rssi[j];
+            rssi[j] = tmp;
+        }
+        int count = 0;
+        for (int n = 0; n < 100 && count < MAX_RECORDS; n++) {
+            if (rand() % 3 == 0) {
+                scan[count++] = ap(n, rssi[n]);
+            }
+        }
+
+        // Merged into a private list and copied to the shown one, as the app does
+        wifi_ap_list_update(&list, scan, count);
+        wifi_ap_list_copy(&shown, &list);
+        CHECK(shown.count == list.count && shown.entries != list.entries &&
+              memcmp(shown.entries, list.entries, sizeof(list.entries[0]) * list.count) == 0,
+              "scan %d: copy differs from the merged list", s);
+
+        memcpy(expected, scan, sizeof(scan[0]) * count);
+        qsort(expected, count, sizeof(expected[0]), record_before);
+        int expected_count = count < capacity ? count : capacity;
+        CHECK(list.count == expected_count, "scan %d: %d entries, expected %d", s, list.count, expected_count);
+        CHECK(list.dropped == count - expected_count, "scan %d: %d dropped, expected %d", s,
+              list.dropped, count - expected_count);
+        for (int i = 0; i < expected_count && i < list.count; i++) {
+            const wifi_ap_entry_t *entry = &list.entries[i];
+            CHECK(memcmp(entry->bssid, expected[i].bssid, sizeof(entry->bssid)) == 0 &&
+                  entry->rssi == expected[i].rssi &&
+                  strcmp(entry->ssid, (const char *) expected[i].ssid) == 0,
+                  "scan %d: row %d is %s (%d), expected %s (%d)", s, i,
+                  entry->ssid, entry->rssi, (const char *) expected[i].ssid, expected[i].rssi);
+        }
+    }
+    free(list.entries);
+    free(shown.entries);
+}
+
+int main(int argc, char **argv)
+{
+    int scans = 1000;
+    int opt;
+    while ((opt = getopt(argc, argv, "n:")) != -1) {
+        switch (opt) {
+        case 'n':
+            scans = atoi(optarg);
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-n random scans]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    srand(1);
+    check_fixed();
+    const int capacities[] = { 1, 4, 16, 32, MAX_RECORDS };
+    for (size_t i = 0; i < sizeof(capacities) / sizeof(capacities[0]); i++) {
+        check_random(scans, capacities[i]);
+    }
+
+    printf("%s\n", failures ? "FAILED" : "OK");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,11 @@
+/* The fields of wifi_ap_record_t used by wifi_ap_list.c, laid out as in ESP-IDF */
+#pragma once
+
+#include <stdint.h>
+
+typedef struct {
+    uint8_t bssid[6];
+    uint8_t ssid[33];
+    uint8_t primary;
+    int8_t rssi;
+} wifi_ap_record_t;
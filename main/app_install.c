@@ -0,0 +1,433 @@
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+#include "esp_system.h"
+#include "esp_partition.h"
+#include "esp_ota_ops.h"
+#include "mbedtls/sha256.h"
+#include "app_install.h"
+
+#if CONFIG_GRAPHICAL_BOOTLOADER_SERIAL_INSTALL_USB_SERIAL_JTAG
+#include "driver/usb_serial_jtag.h"
+#elif CONFIG_GRAPHICAL_BOOTLOADER_SERIAL_INSTALL_UART
+#include "driver/uart.h"
+#endif
+
+#define INSTALL_BUFFERS         2
+#define INSTALL_TASK_STACK      4096
+#define SERIAL_TASK_STACK       4096
+#define SERIAL_RX_BUFFER        8192
+#define SERIAL_TIMEOUT_MS       2000
+
+typedef struct {
+    uint8_t *data;              // NULL ends the stream
+    size_t len;
+} install_block_t;
+
+typedef struct {
+    app_install_read_fn read;
+    void *ctx;
+    uint32_t block_size;
+    uint32_t image_size;
+    uint8_t *compressed;
+    QueueHandle_t free_queue;
+    QueueHandle_t filled_queue;
+    volatile bool abort;
+    esp_err_t result;
+    uint32_t package_bytes;
+} install_job_t;
+
+static const char *TAG = "app_install";
+
+/* LZ4 block format decoder. Returns the decoded size or -1 on malformed input. */
+static int lz4_decompress(const uint8_t *src, size_t src_len, uint8_t *dst, size_t dst_len)
+{
+    const uint8_t *ip = src;
+    const uint8_t *iend = src + src_len;
+    uint8_t *op = dst;
+    uint8_t *oend = dst + dst_len;
+
+    while (ip < iend) {
+        uint8_t token = *ip++;
+        size_t len = token >> 4;
+        if (len == 15) {
+            uint8_t b;
+            do {
+                if (ip >= iend) {
+                    return -1;
+                }
+                b = *ip++;
+                len += b;
+            } while (b == 255);
+        }
+        if (len > (size_t) (iend - ip) || len > (size_t) (oend - op)) {
+            return -1;
+        }
+        memcpy(op, ip, len);
+        op += len;
+        ip += len;
+        // The last sequence carries literals only
+        if (ip == iend) {
+            break;
+        }
+
+        if (iend - ip < 2) {
+            return -1;
+        }
+        size_t offset = ip[0] | (ip[1] << 8);
+        ip += 2;
+        if (offset == 0 || offset > (size_t) (op - dst)) {
+            return -1;
+        }
+        len = token & 0x0f;
+        if (len == 15) {
+            uint8_t b;
+            do {
+                if (ip >= iend) {
+                    return -1;
+                }
+                b = *ip++;
+                len += b;
+            } while (b == 255);
+        }
+        len += 4;
+        if (len > (size_t) (oend - op)) {
+            return -1;
+        }
+        // Byte by byte, the match may overlap the output
+        const uint8_t *match = op - offset;
+        while (len--) {
+            *op++ = *match++;
+        }
+    }
+    return op - dst;
+}
+
+static esp_err_t install_read_block(install_job_t *job, uint8_t *out, size_t raw_len)
+{
+    uint32_t stored;
+    if (job->read(job->ctx, (uint8_t *) &stored, sizeof(stored)) != sizeof(stored)) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    bool raw = stored & APP_PACKAGE_BLOCK_RAW;
+    stored &= ~APP_PACKAGE_BLOCK_RAW;
+    if (stored > job->block_size || (raw && stored != raw_len)) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    uint8_t *dst = raw ? out : job->compressed;
+    if (job->read(job->ctx, dst, stored) != stored) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    job->package_bytes += sizeof(stored) + stored;
+    if (!raw && lz4_decompress(job->compressed, stored, out, raw_len) != (int) raw_len) {
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+    return ESP_OK;
+}
+
+/* Producer: read and decompress the next block while the previous one is written to flash */
+static void install_reader_task(void *arg)
+{
+    install_job_t *job = arg;
+    uint32_t produced = 0;
+    install_block_t block;
+
+    job->result = ESP_OK;
+    while (produced < job->image_size) {
+        xQueueReceive(job->free_queue, &block, portMAX_DELAY);
+        if (job->abort) {
+            break;
+        }
+        block.len = job->image_size - produced;
+        if (block.len > job->block_size) {
+            block.len = job->block_size;
+        }
+        job->result = install_read_block(job, block.data, block.len);
+        if (job->result != ESP_OK) {
+            break;
+        }
+        produced += block.len;
+        xQueueSend(job->filled_queue, &block, portMAX_DELAY);
+    }
+
+    // The job belongs to the consumer once the end marker is sent
+    block.data = NULL;
+    block.len = 0;
+    xQueueSend(job->filled_queue, &block, portMAX_DELAY);
+    vTaskDelete(NULL);
+}
+
+static const esp_partition_t *install_target(const app_package_header_t *header)
+{
+    if (memcmp(header->magic, APP_PACKAGE_MAGIC, sizeof(header->magic)) != 0 ||
+            header->version != APP_PACKAGE_VERSION) {
+        ESP_LOGE(TAG, "Not an application package");
+        return NULL;
+    }
+    if (header->block_size == 0 || header->block_size > APP_PACKAGE_MAX_BLOCK_SIZE) {
+        ESP_LOGE(TAG, "Unsupported block size %" PRIu32, header->block_size);
+        return NULL;
+    }
+    if (header->slot >= ESP_PARTITION_SUBTYPE_APP_OTA_MAX - ESP_PARTITION_SUBTYPE_APP_OTA_MIN) {
+        ESP_LOGE(TAG, "Invalid slot ota_%u", header->slot);
+        return NULL;
+    }
+    const esp_partition_t *partition = esp_partition_find_first(ESP_PARTITION_TYPE_APP,
+                                       ESP_PARTITION_SUBTYPE_APP_OTA_MIN + header->slot, NULL);
+    if (partition == NULL) {
+        ESP_LOGE(TAG, "No partition ota_%u", header->slot);
+        return NULL;
+    }
+    if (header->image_size > partition->size) {
+        ESP_LOGE(TAG, "Image of %" PRIu32 " bytes does not fit %s", header->image_size, partition->label);
+        return NULL;
+    }
+    return partition;
+}
+
+esp_err_t app_install_stream(app_install_read_fn read, void *ctx, app_install_stats_t *stats)
+{
+    int64_t start = esp_timer_get_time();
+    app_package_header_t header;
+    if (read(ctx, (uint8_t *) &header, sizeof(header)) != sizeof(header)) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    const esp_partition_t *partition = install_target(&header);
+    if (partition == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    ESP_LOGI(TAG, "Installing %" PRIu32 " bytes into %s", header.image_size, partition->label);
+
+    install_job_t job = {
+        .read = read,
+        .ctx = ctx,
+        .block_size = header.block_size,
+        .image_size = header.image_size,
+        .package_bytes = sizeof(header),
+    };
+    uint8_t *buffers[INSTALL_BUFFERS] = { NULL };
+    esp_ota_handle_t ota = 0;
+    esp_err_t ret = ESP_ERR_NO_MEM;
+
+    job.compressed = heap_caps_malloc(job.block_size, MALLOC_CAP_DEFAULT);
+    job.free_queue = xQueueCreate(INSTALL_BUFFERS, sizeof(install_block_t));
+    job.filled_queue = xQueueCreate(INSTALL_BUFFERS + 1, sizeof(install_block_t));
+    for (size_t i = 0; i < INSTALL_BUFFERS; i++) {
+        buffers[i] = heap_caps_malloc(job.block_size, MALLOC_CAP_DEFAULT);
+    }
+    if (job.compressed == NULL || job.free_queue == NULL || job.filled_queue == NULL ||
+            buffers[0] == NULL || buffers[INSTALL_BUFFERS - 1] == NULL) {
+        goto cleanup;
+    }
+
+    // Erase as the image is written, so erasing overlaps with the transfer
+    ret = esp_ota_begin(partition, OTA_WITH_SEQUENTIAL_WRITES, &ota);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "esp_ota_begin failed: %s", esp_err_to_name(ret));
+        goto cleanup;
+    }
+
+    for (size_t i = 0; i < INSTALL_BUFFERS; i++) {
+        install_block_t block = { .data = buffers[i] };
+        xQueueSend(job.free_queue, &block, 0);
+    }
+    if (xTaskCreate(install_reader_task, "app_install", INSTALL_TASK_STACK, &job,
+                    uxTaskPriorityGet(NULL), NULL) != pdPASS) {
+        esp_ota_abort(ota);
+        ret = ESP_ERR_NO_MEM;
+        goto cleanup;
+    }
+
+    mbedtls_sha256_context sha;
+    mbedtls_sha256_init(&sha);
+    mbedtls_sha256_starts(&sha, 0);
+
+    uint32_t written = 0;
+    int64_t write_us = 0;
+    ret = ESP_OK;
+    while (1) {
+        install_block_t block;
+        xQueueReceive(job.filled_queue, &block, portMAX_DELAY);
+        if (block.data == NULL) {
+            break;
+        }
+        if (ret == ESP_OK) {
+            mbedtls_sha256_update(&sha, block.data, block.len);
+            int64_t write_start = esp_timer_get_time();
+            ret = esp_ota_write(ota, block.data, block.len);
+            write_us += esp_timer_get_time() - write_start;
+            written += block.len;
+            if (ret != ESP_OK) {
+                ESP_LOGE(TAG, "esp_ota_write failed: %s", esp_err_to_name(ret));
+                job.abort = true;
+            }
+        }
+        // Keep draining until the reader is done with the job
+        xQueueSend(job.free_queue, &block, portMAX_DELAY);
+    }
+
+    uint8_t digest[32];
+    mbedtls_sha256_finish(&sha, digest);
+    mbedtls_sha256_free(&sha);
+
+    if (ret == ESP_OK && job.result != ESP_OK) {
+        ESP_LOGE(TAG, "Package data broken after %" PRIu32 " bytes: %s", written, esp_err_to_name(job.result));
+        ret = job.result;
+    }
+    if (ret == ESP_OK && (written != header.image_size || memcmp(digest, header.sha256, sizeof(digest)) != 0)) {
+        ESP_LOGE(TAG, "SHA-256 mismatch");
+        ret = ESP_ERR_INVALID_CRC;
+    }
+    if (ret != ESP_OK) {
+        esp_ota_abort(ota);
+        goto cleanup;
+    }
+    // Also validates the app image
+    ret = esp_ota_end(ota);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "esp_ota_end failed: %s", esp_err_to_name(ret));
+        goto cleanup;
+    }
+
+    int64_t total_us = esp_timer_get_time() - start;
+    ESP_LOGI(TAG, "Installed %s: %" PRIu32 " bytes from %" PRIu32 " in %" PRId64 " ms (%" PRId64 " KB/s), flash writes %" PRId64 " ms",
+             partition->label, written, job.package_bytes, total_us / 1000,
+             total_us > 0 ? (int64_t) written * 1000000 / 1024 / total_us : 0, write_us / 1000);
+    if (stats) {
+        stats->package_bytes = job.package_bytes;
+        stats->image_bytes = written;
+        stats->total_us = total_us;
+        stats->write_us = write_us;
+    }
+
+cleanup:
+    for (size_t i = 0; i < INSTALL_BUFFERS; i++) {
+        heap_caps_free(buffers[i]);
+    }
+    heap_caps_free(job.compressed);
+    if (job.free_queue) {
+        vQueueDelete(job.free_queue);
+    }
+    if (job.filled_queue) {
+        vQueueDelete(job.filled_queue);
+    }
+    return ret;
+}
+
+static size_t file_read(void *ctx, uint8_t *buf, size_t len)
+{
+    return fread(buf, 1, len, (FILE *) ctx);
+}
+
+esp_err_t app_install_from_file(const char *path, app_install_stats_t *stats)
+{
+    FILE *f = fopen(path, "rb");
+    if (f == NULL) {
+        ESP_LOGE(TAG, "Cannot open %s", path);
+        return ESP_ERR_NOT_FOUND;
+    }
+    esp_err_t ret = app_install_stream(file_read, f, stats);
+    fclose(f);
+    return ret;
+}
+
+#if CONFIG_GRAPHICAL_BOOTLOADER_SERIAL_INSTALL
+
+typedef struct {
+    uint8_t pending[sizeof(((app_package_header_t *) 0)->magic)];
+    size_t pending_len;
+} serial_source_t;
+
+static size_t serial_read_raw(uint8_t *buf, size_t len, TickType_t timeout)
+{
+    size_t got = 0;
+    while (got < len) {
+#if CONFIG_GRAPHICAL_BOOTLOADER_SERIAL_INSTALL_USB_SERIAL_JTAG
+        int n = usb_serial_jtag_read_bytes(buf + got, len - got, timeout);
+#else
+        int n = uart_read_bytes(CONFIG_ESP_CONSOLE_UART_NUM, buf + got, len - got, timeout);
+#endif
+        if (n <= 0) {
+            break;
+        }
+        got += n;
+    }
+    return got;
+}
+
+/* Hands out the magic consumed while waiting for a package first */
+static size_t serial_read(void *ctx, uint8_t *buf, size_t len)
+{
+    serial_source_t *src = ctx;
+    size_t got = 0;
+    while (src->pending_len > 0 && got < len) {
+        buf[got++] = src->pending[sizeof(src->pending) - src->pending_len--];
+    }
+    return got + serial_read_raw(buf + got, len - got, pdMS_TO_TICKS(SERIAL_TIMEOUT_MS));
+}
+
+static void serial_wait_for_package(serial_source_t *src)
+{
+    const char *magic = APP_PACKAGE_MAGIC;
+    size_t matched = 0;
+    while (matched < sizeof(src->pending)) {
+        uint8_t c;
+        if (serial_read_raw(&c, 1, portMAX_DELAY) != 1) {
+            continue;
+        }
+        matched = c == magic[matched] ? matched + 1 : (c == magic[0] ? 1 : 0);
+    }
+    memcpy(src->pending, magic, sizeof(src->pending));
+    src->pending_len = sizeof(src->pending);
+}
+
+static void app_install_serial_task(void *arg)
+{
+    serial_source_t src = { 0 };
+    while (1) {
+        serial_wait_for_package(&src);
+        if (app_install_stream(serial_read, &src, NULL) == ESP_OK) {
+            // The registry picks the new application up on the next start
+            ESP_LOGI(TAG, "Restarting to list the new application");
+            vTaskDelay(pdMS_TO_TICKS(100));
+            esp_restart();
+        }
+        src.pending_len = 0;
+    }
+}
+
+esp_err_t app_install_serial_start(void)
+{
+#if CONFIG_GRAPHICAL_BOOTLOADER_SERIAL_INSTALL_USB_SERIAL_JTAG
+    usb_serial_jtag_driver_config_t config = USB_SERIAL_JTAG_DRIVER_CONFIG_DEFAULT();
+    config.rx_buffer_size = SERIAL_RX_BUFFER;
+    esp_err_t ret = usb_serial_jtag_driver_install(&config);
+#else
+    esp_err_t ret = uart_driver_install(CONFIG_ESP_CONSOLE_UART_NUM, SERIAL_RX_BUFFER, 0, 0, NULL, 0);
+#endif
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Serial driver install failed: %s", esp_err_to_name(ret));
+        return ret;
+    }
+    if (xTaskCreate(app_install_serial_task, "app_install_rx", SERIAL_TASK_STACK, NULL,
+                    tskIDLE_PRIORITY + 2, NULL) != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+#else
+
+esp_err_t app_install_serial_start(void)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+#endif
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+/*
+ * Install of compressed application packages into an OTA slot.
+ *
+ * Package layout (little endian), written by tools/pack_app.py:
+ *   app_package_header_t
+ *   blocks: uint32_t stored size (APP_PACKAGE_BLOCK_RAW set when the block is not compressed),
+ *           followed by the LZ4 block. Every block but the last expands to block_size bytes.
+ */
+
+#define APP_PACKAGE_MAGIC           "GBLZ"
+#define APP_PACKAGE_VERSION         1
+#define APP_PACKAGE_BLOCK_RAW       0x80000000u
+#define APP_PACKAGE_MAX_BLOCK_SIZE  (64 * 1024)
+
+typedef struct __attribute__((packed)) {
+    char magic[4];
+    uint8_t version;
+    uint8_t slot;               // target ota_N
+    uint16_t reserved;
+    uint32_t block_size;
+    uint32_t image_size;
+    uint8_t sha256[32];         // of the uncompressed image
+} app_package_header_t;
+
+typedef struct {
+    uint32_t package_bytes;
+    uint32_t image_bytes;
+    int64_t total_us;
+    int64_t write_us;           // time spent in esp_ota_write
+} app_install_stats_t;
+
+/* Read exactly len bytes into buf. Return the number of bytes read, less on end of data or error. */
+typedef size_t (*app_install_read_fn)(void *ctx, uint8_t *buf, size_t len);
+
+/* Decompress a package from the reader straight into its OTA slot. Reading and decompression
+ * run in a separate task, double buffered with the flash writes. The slot is left untouched
+ * for the bootloader unless the whole image arrived and its SHA-256 matches. */
+esp_err_t app_install_stream(app_install_read_fn read, void *ctx, app_install_stats_t *stats);
+
+/* Install a package file, e.g. from a mounted SD card */
+esp_err_t app_install_from_file(const char *path, app_install_stats_t *stats);
+
+/* Start a task which installs packages sent over the serial port (tools/pack_app.py --port)
+ * and restarts so the menu lists the new application */
+esp_err_t app_install_serial_start(void);
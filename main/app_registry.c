@@ -0,0 +1,161 @@
+#include <stddef.h>
+#include <string.h>
+#include "esp_log.h"
+#include "esp_ota_ops.h"
+#include "esp_app_format.h"
+#include "nvs.h"
+#include "app_registry.h"
+
+#define NVS_NAMESPACE       "bootloader"
+#define NVS_KEY_MANIFEST    "manifest"
+#define MANIFEST_VERSION    1
+
+// The app descriptor follows the image header and the first segment header
+#define APP_DESC_OFFSET     (sizeof(esp_image_header_t) + sizeof(esp_image_segment_header_t))
+#define APP_ELF_SHA_OFFSET  (APP_DESC_OFFSET + offsetof(esp_app_desc_t, app_elf_sha256))
+#define APP_ELF_SHA_LEN     sizeof(((esp_app_desc_t *)0)->app_elf_sha256)
+
+typedef struct {
+    uint8_t subtype;
+    uint8_t valid;
+    uint8_t app_elf_sha256[APP_ELF_SHA_LEN];
+    char project_name[32];
+    char version[32];
+} manifest_entry_t;
+
+typedef struct {
+    uint16_t version;
+    uint16_t count;
+    manifest_entry_t entries[APP_REGISTRY_MAX_APPS];
+} manifest_t;
+
+static const char *TAG = "app_registry";
+
+static app_entry_t s_apps[APP_REGISTRY_MAX_APPS];
+static size_t s_app_count = 0;
+
+static size_t manifest_size(const manifest_t *manifest)
+{
+    return offsetof(manifest_t, entries) + manifest->count * sizeof(manifest_entry_t);
+}
+
+static void manifest_load(manifest_t *manifest)
+{
+    nvs_handle_t nvs;
+    size_t size = sizeof(*manifest);
+
+    manifest->count = 0;
+    if (nvs_open(NVS_NAMESPACE, NVS_READONLY, &nvs) != ESP_OK) {
+        return;
+    }
+    if (nvs_get_blob(nvs, NVS_KEY_MANIFEST, manifest, &size) != ESP_OK ||
+            manifest->version != MANIFEST_VERSION || manifest->count > APP_REGISTRY_MAX_APPS ||
+            size != manifest_size(manifest)) {
+        manifest->count = 0;
+    }
+    nvs_close(nvs);
+}
+
+static esp_err_t manifest_store(const manifest_t *manifest)
+{
+    nvs_handle_t nvs;
+    esp_err_t ret = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &nvs);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    ret = nvs_set_blob(nvs, NVS_KEY_MANIFEST, manifest, manifest_size(manifest));
+    if (ret == ESP_OK) {
+        ret = nvs_commit(nvs);
+    }
+    nvs_close(nvs);
+    return ret;
+}
+
+static const manifest_entry_t *manifest_find(const manifest_t *manifest, uint8_t subtype)
+{
+    for (size_t i = 0; i < manifest->count; i++) {
+        if (manifest->entries[i].subtype == subtype) {
+            return &manifest->entries[i];
+        }
+    }
+    return NULL;
+}
+
+/* Read the slot's app descriptor only when its ELF SHA differs from the cached one */
+static bool manifest_refresh_entry(const esp_partition_t *partition, const manifest_entry_t *cached,
+                                   manifest_entry_t *entry)
+{
+    uint8_t sha[APP_ELF_SHA_LEN];
+    if (esp_partition_read(partition, APP_ELF_SHA_OFFSET, sha, sizeof(sha)) != ESP_OK) {
+        memset(sha, 0xff, sizeof(sha));
+    }
+
+    if (cached && memcmp(cached->app_elf_sha256, sha, sizeof(sha)) == 0) {
+        *entry = *cached;
+        return false;
+    }
+
+    memset(entry, 0, sizeof(*entry));
+    entry->subtype = partition->subtype;
+    memcpy(entry->app_elf_sha256, sha, sizeof(sha));
+
+    esp_app_desc_t desc;
+    if (esp_ota_get_partition_description(partition, &desc) == ESP_OK) {
+        entry->valid = 1;
+        strlcpy(entry->project_name, desc.project_name, sizeof(entry->project_name));
+        strlcpy(entry->version, desc.version, sizeof(entry->version));
+    }
+    ESP_LOGI(TAG, "%s: changed, %s", partition->label, entry->valid ? entry->project_name : "empty");
+    return true;
+}
+
+esp_err_t app_registry_init(void)
+{
+    static manifest_t cached, manifest;
+    bool changed = false;
+
+    manifest_load(&cached);
+    manifest.version = MANIFEST_VERSION;
+    manifest.count = 0;
+    s_app_count = 0;
+
+    // Partitions are returned in partition table order, i.e. ota_0 first
+    esp_partition_iterator_t it = esp_partition_find(ESP_PARTITION_TYPE_APP, ESP_PARTITION_SUBTYPE_ANY, NULL);
+    for (; it != NULL && manifest.count < APP_REGISTRY_MAX_APPS; it = esp_partition_next(it)) {
+        const esp_partition_t *partition = esp_partition_get(it);
+        if (partition->subtype < ESP_PARTITION_SUBTYPE_APP_OTA_MIN ||
+                partition->subtype >= ESP_PARTITION_SUBTYPE_APP_OTA_MAX) {
+            continue;
+        }
+
+        manifest_entry_t *entry = &manifest.entries[manifest.count++];
+        changed |= manifest_refresh_entry(partition, manifest_find(&cached, partition->subtype), entry);
+        if (!entry->valid) {
+            continue;
+        }
+
+        app_entry_t *app = &s_apps[s_app_count++];
+        app->partition = partition;
+        memcpy(app->project_name, entry->project_name, sizeof(app->project_name));
+        memcpy(app->version, entry->version, sizeof(app->version));
+    }
+    esp_partition_iterator_release(it);
+
+    changed |= manifest.count != cached.count;
+    if (changed && manifest_store(&manifest) != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to store app manifest");
+    }
+    ESP_LOGI(TAG, "%u app(s), manifest %s", (unsigned) s_app_count, changed ? "rebuilt" : "up to date");
+
+    return s_app_count > 0 ? ESP_OK : ESP_ERR_NOT_FOUND;
+}
+
+size_t app_registry_count(void)
+{
+    return s_app_count;
+}
+
+const app_entry_t *app_registry_get(size_t index)
+{
+    return index < s_app_count ? &s_apps[index] : NULL;
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <stddef.h>
+#include "esp_err.h"
+#include "esp_partition.h"
+
+/* OTA app subtypes are ota_0 .. ota_15 */
+#define APP_REGISTRY_MAX_APPS 16
+
+typedef struct {
+    const esp_partition_t *partition;
+    char project_name[32];
+    char version[32];
+} app_entry_t;
+
+/* Enumerate OTA app partitions holding a valid image. Call once at startup. */
+esp_err_t app_registry_init(void);
+
+size_t app_registry_count(void);
+
+/* Returns NULL when index is out of range */
+const app_entry_t *app_registry_get(size_t index);
@@ -0,0 +1,109 @@
+#include <stdio.h>
+#include <stdbool.h>
+#include "esp_attr.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "boot_trace.h"
+
+// Without the option boot_trace.h has empty inline versions of everything below
+#if CONFIG_GRAPHICAL_BOOTLOADER_BOOT_TRACE
+
+#define BOOT_TRACE_MAGIC    0x42545243
+#define BOOT_TRACE_ENTRIES  CONFIG_GRAPHICAL_BOOTLOADER_BOOT_TRACE_ENTRIES
+
+typedef struct {
+    uint16_t boot;
+    uint8_t stage;
+    uint8_t reserved;
+    uint32_t time_us;
+} boot_trace_entry_t;
+
+typedef struct {
+    uint32_t magic;
+    uint16_t boot;
+    uint16_t head;
+    uint16_t count;
+    uint16_t reserved;
+    boot_trace_entry_t entries[BOOT_TRACE_ENTRIES];
+} boot_trace_t;
+
+static const char *const stage_names[BOOT_STAGE_MAX] = {
+    [BOOT_STAGE_APP_MAIN] = "app_main",
+    [BOOT_STAGE_FAST_BOOT] = "fast_boot",
+    [BOOT_STAGE_DISPLAY_START] = "display_start",
+    [BOOT_STAGE_DISPLAY_READY] = "display_ready",
+    [BOOT_STAGE_UI_START] = "ui_start",
+    [BOOT_STAGE_UI_READY] = "ui_ready",
+    [BOOT_STAGE_BACKLIGHT_ON] = "backlight_on",
+    [BOOT_STAGE_FIRST_FRAME] = "first_frame",
+    [BOOT_STAGE_APP_SWITCH] = "app_switch",
+};
+
+// Not cleared by software resets, so the record of the previous boot stays available
+static RTC_NOINIT_ATTR boot_trace_t s_trace;
+static bool s_first_frame_seen = false;
+
+void boot_trace_init(void)
+{
+    if (esp_reset_reason() == ESP_RST_POWERON || s_trace.magic != BOOT_TRACE_MAGIC ||
+            s_trace.head >= BOOT_TRACE_ENTRIES || s_trace.count > BOOT_TRACE_ENTRIES) {
+        s_trace.magic = BOOT_TRACE_MAGIC;
+        s_trace.boot = 0;
+        s_trace.head = 0;
+        s_trace.count = 0;
+    } else {
+        s_trace.boot++;
+    }
+}
+
+void boot_trace_mark(boot_stage_t stage)
+{
+    if (s_trace.magic != BOOT_TRACE_MAGIC || stage >= BOOT_STAGE_MAX) {
+        return;
+    }
+
+    boot_trace_entry_t *entry = &s_trace.entries[s_trace.head];
+    entry->boot = s_trace.boot;
+    entry->stage = stage;
+    entry->time_us = (uint32_t) esp_timer_get_time();
+
+    s_trace.head = (s_trace.head + 1) % BOOT_TRACE_ENTRIES;
+    if (s_trace.count < BOOT_TRACE_ENTRIES) {
+        s_trace.count++;
+    }
+}
+
+static void boot_trace_refr_ready_cb(lv_event_t *e)
+{
+    if (s_first_frame_seen) {
+        return;
+    }
+    s_first_frame_seen = true;
+    boot_trace_mark(BOOT_STAGE_FIRST_FRAME);
+    boot_trace_dump();
+}
+
+void boot_trace_watch_first_frame(lv_display_t *disp)
+{
+    if (disp) {
+        lv_display_add_event_cb(disp, boot_trace_refr_ready_cb, LV_EVENT_REFR_READY, NULL);
+    }
+}
+
+void boot_trace_dump(void)
+{
+    if (s_trace.magic != BOOT_TRACE_MAGIC) {
+        return;
+    }
+
+    uint16_t first = (s_trace.head + BOOT_TRACE_ENTRIES - s_trace.count) % BOOT_TRACE_ENTRIES;
+    for (uint16_t i = 0; i < s_trace.count; i++) {
+        const boot_trace_entry_t *entry = &s_trace.entries[(first + i) % BOOT_TRACE_ENTRIES];
+        if (entry->stage < BOOT_STAGE_MAX) {
+            printf("BT,%u,%s,%lu\n", entry->boot, stage_names[entry->stage], (unsigned long) entry->time_us);
+        }
+    }
+    fflush(stdout);
+}
+
+#endif
@@ -0,0 +1,36 @@
+#pragma once
+
+#include "sdkconfig.h"
+#include "lvgl.h"
+
+typedef enum {
+    BOOT_STAGE_APP_MAIN = 0,
+    BOOT_STAGE_FAST_BOOT,
+    BOOT_STAGE_DISPLAY_START,
+    BOOT_STAGE_DISPLAY_READY,
+    BOOT_STAGE_UI_START,
+    BOOT_STAGE_UI_READY,
+    BOOT_STAGE_BACKLIGHT_ON,
+    BOOT_STAGE_FIRST_FRAME,
+    BOOT_STAGE_APP_SWITCH,
+    BOOT_STAGE_MAX,
+} boot_stage_t;
+
+#if CONFIG_GRAPHICAL_BOOTLOADER_BOOT_TRACE
+/* Validate the RTC ring buffer and start a new boot record */
+void boot_trace_init(void);
+
+/* Record the current esp_timer_get_time() for the given stage */
+void boot_trace_mark(boot_stage_t stage);
+
+/* Record BOOT_STAGE_FIRST_FRAME once the display finished its first refresh */
+void boot_trace_watch_first_frame(lv_display_t *disp);
+
+/* Print all recorded entries as "BT,<boot>,<stage>,<us>" lines */
+void boot_trace_dump(void);
+#else
+static inline void boot_trace_init(void) {}
+static inline void boot_trace_mark(boot_stage_t stage) { (void) stage; }
+static inline void boot_trace_watch_first_frame(lv_display_t *disp) { (void) disp; }
+static inline void boot_trace_dump(void) {}
+#endif
@@ -1,4 +1,7 @@
 #include <math.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <string.h>
 #include <sys/time.h>
 #include "lvgl.h"
 #include "esp_log.h"
@@ -6,6 +9,11 @@
 #include "esp_system.h"
 #include "bsp/esp-bsp.h"
 #include "esp_timer.h"
+#include "fast_boot.h"
+#include "boot_trace.h"
+#include "app_registry.h"
+#include "icon_loader.h"
+#include "menu_input.h"
 
 typedef struct {
     lv_obj_t *scr;
@@ -20,21 +28,29 @@ typedef struct {
 } button_style_t;
 
 typedef struct {
-    char *name;
-    void *img_src;
-    void (*start_fn)(void (*fn)(void));
-    void (*end_fn)(void);
+    const char *name;
+    const void *img_src;
 } item_desc_t;
 
+typedef struct {
+    const char *project_name;
+    const char *name;
+    const void *img_src;
+} known_app_t;
+
 static const char *TAG = "bootloader_ui";
 
+// Swipe speed, in pixels per second, for each item a fling moves past the first
+#define MENU_FLING_SPEED_PER_ITEM 500
+
 LV_FONT_DECLARE(font_icon_16);
 
 static int g_item_index = 0;
 static lv_group_t *g_btn_op_group = NULL;
 static button_style_t g_btn_styles;
 static lv_obj_t *g_page_menu = NULL;
-static int64_t last_btn_press_time = 0;
+static lv_point_t g_press_point;
+static uint32_t g_press_tick = 0;
 
 static lv_obj_t *g_focus_last_obj = NULL;
 static lv_obj_t *g_group_list[3] = {0};
@@ -45,26 +61,26 @@ LV_IMG_DECLARE(icon_calculator)
 LV_IMG_DECLARE(icon_synth_piano)
 LV_IMG_DECLARE(icon_game_of_life)
 
-void ui_app1_start(void (*fn)(void));
-void ui_app2_start(void (*fn)(void));
-void ui_app3_start(void (*fn)(void));
-void ui_app4_start(void (*fn)(void));
-void ui_app5_start(void (*fn)(void));
-
-static item_desc_t item[] = {
-    { "Tic-Tac-Toe", (void *) &icon_tic_tac_toe, ui_app1_start, NULL},
-    { "Wi-Fi List", (void *) &icon_wifi_list, ui_app2_start, NULL},
-    { "Calculator", (void *) &icon_calculator, ui_app3_start, NULL},
-    { "Piano", (void *) &icon_synth_piano, ui_app4_start, NULL},
-    { "Game of Life", (void *) &icon_game_of_life, ui_app5_start, NULL},
+// Names and icons of the applications shipped with the bootloader, keyed by project name
+static const known_app_t known_apps[] = {
+    { "tic_tac_toe", "Tic-Tac-Toe", &icon_tic_tac_toe },
+    { "wifi_list", "Wi-Fi List", &icon_wifi_list },
+    { "calculator", "Calculator", &icon_calculator },
+    { "synth_piano", "Piano", &icon_synth_piano },
+    { "game_of_life", "Game of Life", &icon_game_of_life },
 };
 
+static item_desc_t item[APP_REGISTRY_MAX_APPS];
+
 static lv_obj_t *g_img_btn, *g_img_item = NULL;
 static lv_obj_t *g_lab_item = NULL;
-static lv_obj_t *g_led_item[5];
-static size_t g_item_size = sizeof(item) / sizeof(item[0]);
+static lv_obj_t *g_led_item[APP_REGISTRY_MAX_APPS];
+static size_t g_item_size = 0;
 static lv_obj_t *g_status_bar = NULL;
 
+static void ota_swich_to_app(int app_index);
+static void ui_item_show(int index);
+
 static uint32_t menu_get_num_offset(uint32_t focus, int32_t max, int32_t offset)
 {
     if (focus >= max) {
@@ -165,54 +181,121 @@ static int8_t menu_direct_probe(lv_obj_t *focus_obj)
     return direct;
 }
 
+#if CONFIG_GRAPHICAL_BOOTLOADER_MENU_FRAME_STATS
+// Moves summed up per log line
+#define FRAME_STATS_MOVES 16
+
+static int64_t g_step_time = 0;
+static int64_t g_refr_start_time = 0;
+static int g_stats_moves = 0;
+static int64_t g_stats_render_us = 0;
+static int64_t g_stats_render_max_us = 0;
+static int64_t g_stats_input_us = 0;
+
+static void ui_frame_stats_cb(lv_event_t *e)
+{
+    int64_t now = esp_timer_get_time();
+
+    if (LV_EVENT_REFR_START == lv_event_get_code(e)) {
+        g_refr_start_time = now;
+    } else if (g_step_time != 0) {
+        int64_t render_us = now - g_refr_start_time;
+        ESP_LOGD(TAG, "frame: render %" PRId64 " us, input to frame %" PRId64 " us",
+                 render_us, now - g_step_time);
+        g_stats_render_us += render_us;
+        g_stats_render_max_us = LV_MAX(g_stats_render_max_us, render_us);
+        g_stats_input_us += now - g_step_time;
+        g_step_time = 0;
+
+        if (++g_stats_moves == FRAME_STATS_MOVES) {
+            ESP_LOGI(TAG, "%d moves: render avg %" PRId64 " us, max %" PRId64
+                     " us, input to frame avg %" PRId64 " us", g_stats_moves,
+                     g_stats_render_us / g_stats_moves, g_stats_render_max_us,
+                     g_stats_input_us / g_stats_moves);
+            g_stats_moves = 0;
+            g_stats_render_us = 0;
+            g_stats_render_max_us = 0;
+            g_stats_input_us = 0;
+        }
+    }
+}
+#endif
+
+static void menu_step_cb(int steps)
+{
+#if CONFIG_GRAPHICAL_BOOTLOADER_MENU_FRAME_STATS
+    g_step_time = esp_timer_get_time();
+#endif
+    lv_led_off(g_led_item[g_item_index]);
+    g_item_index = menu_get_num_offset(g_item_index, g_item_size, steps);
+    lv_led_on(g_led_item[g_item_index]);
+    ui_item_show(g_item_index);
+}
+
 static void menu_prev_cb(lv_event_t *e)
 {
-    bsp_display_lock(0);
     lv_event_code_t code = lv_event_get_code(e);
 
-    if (LV_EVENT_RELEASED == code) {
-        int64_t now = esp_timer_get_time();
-        if (now - last_btn_press_time < 500000) { // 500 ms debounce time
-            bsp_display_unlock();
-            return;
-        }
-        last_btn_press_time = now;
-
-        lv_led_off(g_led_item[g_item_index]);
-        if (0 == g_item_index) {
-            g_item_index = g_item_size;
-        }
-        g_item_index--;
-        lv_led_on(g_led_item[g_item_index]);
-        lv_img_set_src(g_img_item, item[g_item_index].img_src);
-        lv_label_set_text_static(g_lab_item, item[g_item_index].name);
+    if (LV_EVENT_PRESSED == code) {
+        menu_input_post_press(MENU_INPUT_SRC_PREV, -1);
+    } else if (LV_EVENT_RELEASED == code || LV_EVENT_PRESS_LOST == code) {
+        menu_input_post_release(MENU_INPUT_SRC_PREV);
     }
-    bsp_display_unlock();
 }
 
 static void menu_next_cb(lv_event_t *e)
 {
-    bsp_display_lock(0);
     lv_event_code_t code = lv_event_get_code(e);
 
-    if (LV_EVENT_RELEASED == code) {
-        int64_t now = esp_timer_get_time();
-        if (now - last_btn_press_time < 500000) { // 500 ms debounce time
-            bsp_display_unlock();
-            return;
-        }
-        last_btn_press_time = now;
+    if (LV_EVENT_PRESSED == code) {
+        menu_input_post_press(MENU_INPUT_SRC_NEXT, 1);
+    } else if (LV_EVENT_RELEASED == code || LV_EVENT_PRESS_LOST == code) {
+        menu_input_post_release(MENU_INPUT_SRC_NEXT);
+    }
+}
 
-        lv_led_off(g_led_item[g_item_index]);
-        g_item_index++;
-        if (g_item_index >= g_item_size) {
-            g_item_index = 0;
-        }
-        lv_led_on(g_led_item[g_item_index]);
-        lv_img_set_src(g_img_item, item[g_item_index].img_src);
-        lv_label_set_text_static(g_lab_item, item[g_item_index].name);
+static void menu_press_track_cb(lv_event_t *e)
+{
+    lv_indev_t *indev = lv_indev_active();
+    if (indev) {
+        lv_indev_get_point(indev, &g_press_point);
+        g_press_tick = lv_tick_get();
     }
-    bsp_display_unlock();
+}
+
+static void menu_gesture_cb(lv_event_t *e)
+{
+    lv_indev_t *indev = lv_indev_active();
+    lv_dir_t dir = lv_indev_get_gesture_dir(indev);
+    if (dir != LV_DIR_LEFT && dir != LV_DIR_RIGHT) {
+        return;
+    }
+
+    // A faster swipe moves over more items. The speed is the distance since the press over
+    // its duration, the last read alone depends on the touch poll rate.
+    lv_point_t point;
+    lv_indev_get_point(indev, &point);
+    uint32_t elapsed_ms = lv_tick_elaps(g_press_tick);
+    int32_t speed = abs(point.x - g_press_point.x) * 1000 / (elapsed_ms ? elapsed_ms : 1);
+    int items = 1 + speed / MENU_FLING_SPEED_PER_ITEM;
+
+    // Swiping left brings in the item on the right
+    menu_input_post_fling(dir == LV_DIR_LEFT ? 1 : -1, items);
+}
+
+static void ui_item_show(int index)
+{
+    lv_img_set_src(g_img_item, icon_loader_get(item[index].img_src));
+    lv_label_set_text_static(g_lab_item, item[index].name);
+
+    // Decode both neighbours in the background so the next move is a cache hit
+    icon_loader_prefetch(item[menu_get_num_offset(index, g_item_size, -1)].img_src,
+                         item[menu_get_num_offset(index, g_item_size, 1)].img_src);
+
+    icon_loader_stats_t stats;
+    icon_loader_get_stats(&stats);
+    ESP_LOGD(TAG, "icon cache: %" PRIu32 " hits, %" PRIu32 " misses, %" PRIu32 " prefetched",
+             stats.hits, stats.misses, stats.prefetches);
 }
 
 static void ui_led_set_visible(bool visible)
@@ -238,8 +321,7 @@ void menu_new_item_select(lv_obj_t *obj)
     g_item_index = menu_get_num_offset(g_item_index, g_item_size, direct);
 
     lv_led_on(g_led_item[g_item_index]);
-    lv_img_set_src(g_img_item, item[g_item_index].img_src);
-    lv_label_set_text_static(g_lab_item, item[g_item_index].name);
+    ui_item_show(g_item_index);
     bsp_display_unlock();
 }
 
@@ -253,6 +335,13 @@ static void menu_enter_cb(lv_event_t *e)
         lv_led_off(g_led_item[g_item_index]);
         menu_new_item_select(obj);
     } else if (LV_EVENT_CLICKED == code) {
+        lv_indev_t *indev = lv_indev_active();
+        if (indev && lv_indev_get_gesture_dir(indev) != LV_DIR_NONE) {
+            // Release at the end of a swipe, not a tap on the icon
+            bsp_display_unlock();
+            return;
+        }
+        menu_input_stop();
         lv_obj_t *menu_btn_parent = lv_obj_get_parent(obj);
         ESP_LOGI(TAG, "menu click, item index = %d", g_item_index);
         if (ui_get_btn_op_group()) {
@@ -265,7 +354,7 @@ static void menu_enter_cb(lv_event_t *e)
         lv_obj_del(menu_btn_parent);
         g_focus_last_obj = NULL;
 
-        item[g_item_index].start_fn(item[g_item_index].end_fn);
+        ota_swich_to_app(g_item_index);
     }
     bsp_display_unlock();
 }
@@ -289,6 +378,8 @@ static void ui_main_menu(int32_t index_id)
     lv_obj_set_style_shadow_width(obj, 20, LV_PART_MAIN);
     lv_obj_set_style_shadow_opa(obj, LV_OPA_30, LV_PART_MAIN);
     lv_obj_align(obj, LV_ALIGN_TOP_MID, 0, -10);
+    lv_obj_add_event_cb(obj, menu_gesture_cb, LV_EVENT_GESTURE, NULL);
+    lv_obj_add_event_cb(obj, menu_press_track_cb, LV_EVENT_PRESSED, NULL);
 
     g_img_btn = lv_btn_create(obj);
     lv_obj_set_size(g_img_btn, 108, 108);
@@ -304,17 +395,20 @@ static void ui_main_menu(int32_t index_id)
     lv_obj_set_style_radius(g_img_btn, 40, LV_PART_MAIN);
     lv_obj_align(g_img_btn, LV_ALIGN_CENTER, 0, -20);
     lv_obj_add_event_cb(g_img_btn, menu_enter_cb, LV_EVENT_ALL, g_img_btn);
+    lv_obj_add_event_cb(g_img_btn, menu_press_track_cb, LV_EVENT_PRESSED, NULL);
 
     g_img_item = lv_img_create(g_img_btn);
-    lv_img_set_src(g_img_item, item[index_id].img_src);
     lv_obj_center(g_img_item);
 
     g_lab_item = lv_label_create(obj);
-    lv_label_set_text_static(g_lab_item, item[index_id].name);
+    // Fixed width, so a new name invalidates the same area as the previous one
+    lv_obj_set_width(g_lab_item, 250);
+    lv_obj_set_style_text_align(g_lab_item, LV_TEXT_ALIGN_CENTER, LV_PART_MAIN);
     lv_obj_set_style_text_font(g_lab_item, &lv_font_montserrat_32, LV_PART_MAIN);
     lv_obj_align(g_lab_item, LV_ALIGN_CENTER, 0, 60);
+    ui_item_show(index_id);
 
-    for (size_t i = 0; i < sizeof(g_led_item) / sizeof(g_led_item[0]); i++) {
+    for (size_t i = 0; i < g_item_size; i++) {
         int gap = 10;
         if (NULL == g_led_item[i]) {
             g_led_item[i] = lv_led_create(g_page_menu);
@@ -346,6 +440,7 @@ static void ui_main_menu(int32_t index_id)
     lv_obj_set_style_text_color(label, lv_color_make(5, 5, 5), LV_PART_MAIN);
     lv_obj_center(label);
     lv_obj_add_event_cb(btn_prev, menu_prev_cb, LV_EVENT_ALL, btn_prev);
+    lv_obj_add_event_cb(btn_prev, menu_press_track_cb, LV_EVENT_PRESSED, NULL);
 
 
     lv_obj_t *btn_next = lv_btn_create(obj);
@@ -367,63 +462,44 @@ static void ui_main_menu(int32_t index_id)
     lv_obj_set_style_text_color(label, lv_color_make(5, 5, 5), LV_PART_MAIN);
     lv_obj_center(label);
     lv_obj_add_event_cb(btn_next, menu_next_cb, LV_EVENT_ALL, btn_next);
+    lv_obj_add_event_cb(btn_next, menu_press_track_cb, LV_EVENT_PRESSED, NULL);
 }
 
 
 static void ota_swich_to_app(int app_index) {
-    // Initially assume the first OTA partition, which is typically 'ota_0'
-    const esp_partition_t *next_partition = esp_ota_get_next_update_partition(NULL);
-
-    // Iterate to find the correct OTA partition only if button ID is greater than 1
-    if (app_index > 0 && app_index <= 5) {
-        for (int i = 0; i < app_index; i++) {
-            next_partition = esp_ota_get_next_update_partition(next_partition);
-            if (!next_partition) break;  // If no next partition, break from the loop
-        }
-    }
+    const app_entry_t *app = app_registry_get(app_index);
 
-    // For button 1, next_partition will not change, thus pointing to 'ota_0'
-    if (next_partition && esp_ota_set_boot_partition(next_partition) == ESP_OK) {
-        printf("Setting boot partition to %s\n", next_partition->label);
+    if (app && esp_ota_set_boot_partition(app->partition) == ESP_OK) {
+        printf("Setting boot partition to %s\n", app->partition->label);
+        if (fast_boot_remember_slot(app->partition) != ESP_OK) {
+            ESP_LOGW(TAG, "Failed to remember selected application");
+        }
+        boot_trace_mark(BOOT_STAGE_APP_SWITCH);
         esp_restart();  // Restart to boot from the new partition
     } else {
         printf("Failed to set boot partition\n");
     }
 }
 
-
-
-void ui_app1_start(void (*fn)(void))
-{
-    ESP_LOGI(TAG, "App1 start");
-    ota_swich_to_app(0);
-}
-
-void ui_app2_start(void (*fn)(void))
-{
-    ESP_LOGI(TAG, "App2 start");
-    ota_swich_to_app(1);
-}
-
-void ui_app3_start(void (*fn)(void))
-{
-    ESP_LOGI(TAG, "App3 start");
-    ota_swich_to_app(2);
-}
-
-void ui_app4_start(void (*fn)(void))
+static void ui_items_init(void)
 {
-    ESP_LOGI(TAG, "App4 start");
-    ota_swich_to_app(3);
-}
-
-void ui_app5_start(void (*fn)(void))
-{
-    ESP_LOGI(TAG, "App5 start");
-    ota_swich_to_app(4);
+    g_item_size = app_registry_count();
+    for (size_t i = 0; i < g_item_size; i++) {
+        const app_entry_t *app = app_registry_get(i);
+        item[i].name = app->project_name;
+        item[i].img_src = LV_SYMBOL_FILE;
+        for (size_t j = 0; j < sizeof(known_apps) / sizeof(known_apps[0]); j++) {
+            if (strcmp(app->project_name, known_apps[j].project_name) == 0) {
+                item[i].name = known_apps[j].name;
+                item[i].img_src = known_apps[j].img_src;
+                break;
+            }
+        }
+    }
 }
 
 void bootloader_ui(lv_obj_t *scr) {
+    boot_trace_mark(BOOT_STAGE_UI_START);
     lv_obj_set_style_bg_color(lv_scr_act(), lv_color_make(237, 238, 239), LV_STATE_DEFAULT);
     ui_button_style_init();
 
@@ -439,6 +515,12 @@ void bootloader_ui(lv_obj_t *scr) {
     } else if (lv_indev_get_type(indev) == LV_INDEV_TYPE_POINTER) {
         ESP_LOGI(TAG, "Input device type have pointer");
     }
+    menu_input_init(lv_indev_get_type(indev), menu_step_cb);
+
+#if CONFIG_GRAPHICAL_BOOTLOADER_MENU_FRAME_STATS
+    lv_display_add_event_cb(lv_display_get_default(), ui_frame_stats_cb, LV_EVENT_REFR_START, NULL);
+    lv_display_add_event_cb(lv_display_get_default(), ui_frame_stats_cb, LV_EVENT_REFR_READY, NULL);
+#endif
 
     // Create status bar
     g_status_bar = lv_obj_create(lv_scr_act());
@@ -450,5 +532,15 @@ void bootloader_ui(lv_obj_t *scr) {
     lv_obj_set_style_shadow_width(g_status_bar, 0, LV_PART_MAIN);
     lv_obj_align(g_status_bar, LV_ALIGN_TOP_MID, 0, 0);
 
+    ui_items_init();
+    if (0 == g_item_size) {
+        lv_obj_t *label = lv_label_create(lv_scr_act());
+        lv_label_set_text_static(label, "No applications found");
+        lv_obj_center(label);
+        boot_trace_mark(BOOT_STAGE_UI_READY);
+        return;
+    }
+
     ui_main_menu(g_item_index);
+    boot_trace_mark(BOOT_STAGE_UI_READY);
 }
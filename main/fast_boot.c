@@ -0,0 +1,212 @@
+#include <stdbool.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_ota_ops.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "nvs_flash.h"
+#include "nvs.h"
+#include "driver/gpio.h"
+#include "bsp/esp-bsp.h"
+#include "fast_boot.h"
+#include "boot_trace.h"
+
+// The touch controller of each board, the same bsp_touch_new() uses. Selected in main/CMakeLists.txt.
+#if CONFIG_GRAPHICAL_BOOTLOADER_FAST_BOOT && BSP_CAPS_TOUCH
+#include "esp_lcd_panel_io.h"
+#include "esp_lcd_touch.h"
+#if FAST_BOOT_TOUCH_GT911
+#include "esp_lcd_touch_gt911.h"
+#define FAST_BOOT_TOUCH_IO_CONFIG()     ESP_LCD_TOUCH_IO_I2C_GT911_CONFIG()
+#define fast_boot_touch_driver_new      esp_lcd_touch_new_i2c_gt911
+#elif FAST_BOOT_TOUCH_TT21100
+#include "esp_lcd_touch_tt21100.h"
+#define FAST_BOOT_TOUCH_IO_CONFIG()     ESP_LCD_TOUCH_IO_I2C_TT21100_CONFIG()
+#define fast_boot_touch_driver_new      esp_lcd_touch_new_i2c_tt21100
+#elif FAST_BOOT_TOUCH_FT5X06
+#include "esp_lcd_touch_ft5x06.h"
+#define FAST_BOOT_TOUCH_IO_CONFIG()     ESP_LCD_TOUCH_IO_I2C_FT5x06_CONFIG()
+#define fast_boot_touch_driver_new      esp_lcd_touch_new_i2c_ft5x06
+#endif
+#endif
+#ifdef FAST_BOOT_TOUCH_IO_CONFIG
+#define FAST_BOOT_TOUCH 1
+#else
+#define FAST_BOOT_TOUCH 0
+#endif
+
+#define NVS_NAMESPACE   "bootloader"
+#define NVS_KEY_SLOT    "last_slot"
+#define POLL_PERIOD_MS  10
+#define TOUCH_I2C_HZ    400000
+
+esp_err_t fast_boot_init(void)
+{
+    esp_err_t ret = nvs_flash_init();
+    if (ret == ESP_ERR_NVS_NO_FREE_PAGES || ret == ESP_ERR_NVS_NEW_VERSION_FOUND) {
+        ESP_ERROR_CHECK(nvs_flash_erase());
+        ret = nvs_flash_init();
+    }
+    return ret;
+}
+
+esp_err_t fast_boot_remember_slot(const esp_partition_t *partition)
+{
+    nvs_handle_t nvs;
+    esp_err_t ret = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &nvs);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    uint8_t slot;
+    if (nvs_get_u8(nvs, NVS_KEY_SLOT, &slot) != ESP_OK || slot != partition->subtype) {
+        ret = nvs_set_u8(nvs, NVS_KEY_SLOT, partition->subtype);
+        if (ret == ESP_OK) {
+            ret = nvs_commit(nvs);
+        }
+    }
+    nvs_close(nvs);
+    return ret;
+}
+
+#if CONFIG_GRAPHICAL_BOOTLOADER_FAST_BOOT
+static const char *TAG = "fast_boot";
+
+#if FAST_BOOT_TOUCH
+// Only whether a finger is down matters, so the coordinates are not mirrored and the reset
+// and interrupt lines are left to bsp_display_start(), which sets the controller up again
+static esp_err_t fast_boot_touch_new(esp_lcd_panel_io_handle_t *ret_io, esp_lcd_touch_handle_t *ret_touch)
+{
+    const esp_lcd_touch_config_t touch_config = {
+        .x_max = BSP_LCD_H_RES,
+        .y_max = BSP_LCD_V_RES,
+        .rst_gpio_num = GPIO_NUM_NC,
+        .int_gpio_num = GPIO_NUM_NC,
+    };
+    esp_lcd_panel_io_i2c_config_t io_config = FAST_BOOT_TOUCH_IO_CONFIG();
+    io_config.scl_speed_hz = TOUCH_I2C_HZ;
+
+    esp_err_t ret = bsp_i2c_init();
+    if (ret == ESP_OK) {
+        ret = esp_lcd_new_panel_io_i2c(bsp_i2c_get_handle(), &io_config, ret_io);
+    }
+    if (ret != ESP_OK) {
+        *ret_io = NULL;
+        return ret;
+    }
+    ret = fast_boot_touch_driver_new(*ret_io, &touch_config, ret_touch);
+    if (ret != ESP_OK) {
+        esp_lcd_panel_io_del(*ret_io);
+        *ret_io = NULL;
+    }
+    return ret;
+}
+#endif
+
+static const esp_partition_t *fast_boot_last_slot(void)
+{
+    nvs_handle_t nvs;
+    uint8_t slot;
+
+    if (nvs_open(NVS_NAMESPACE, NVS_READONLY, &nvs) != ESP_OK) {
+        return NULL;
+    }
+    esp_err_t ret = nvs_get_u8(nvs, NVS_KEY_SLOT, &slot);
+    nvs_close(nvs);
+    if (ret != ESP_OK) {
+        return NULL;
+    }
+
+    const esp_partition_t *partition = esp_partition_find_first(ESP_PARTITION_TYPE_APP, slot, NULL);
+    esp_app_desc_t desc;
+    if (partition == NULL || esp_ota_get_partition_description(partition, &desc) != ESP_OK) {
+        ESP_LOGW(TAG, "Remembered slot 0x%02x does not hold a valid app", slot);
+        return NULL;
+    }
+    return partition;
+}
+
+static bool fast_boot_menu_requested(void)
+{
+    int gpio = CONFIG_GRAPHICAL_BOOTLOADER_FAST_BOOT_BUTTON_GPIO;
+    if (gpio >= 0) {
+        gpio_config_t io_conf = {
+            .pin_bit_mask = BIT64(gpio),
+            .mode = GPIO_MODE_INPUT,
+            .pull_up_en = GPIO_PULLUP_ENABLE,
+        };
+        gpio_config(&io_conf);
+    }
+
+#if FAST_BOOT_TOUCH
+    // The touch panel only needs I2C, the display stack stays down
+    esp_lcd_panel_io_handle_t tp_io = NULL;
+    esp_lcd_touch_handle_t tp = NULL;
+    if (fast_boot_touch_new(&tp_io, &tp) != ESP_OK) {
+        ESP_LOGW(TAG, "Touch panel not available, only the button requests the menu");
+        tp = NULL;
+    }
+#endif
+
+    bool requested = false;
+    int64_t deadline = esp_timer_get_time() + CONFIG_GRAPHICAL_BOOTLOADER_FAST_BOOT_WINDOW_MS * 1000LL;
+    do {
+        if (gpio >= 0 && gpio_get_level(gpio) == 0) {
+            requested = true;
+            break;
+        }
+#if FAST_BOOT_TOUCH
+        if (tp) {
+            uint16_t x, y;
+            uint8_t points = 0;
+            esp_lcd_touch_read_data(tp);
+            if (esp_lcd_touch_get_coordinates(tp, &x, &y, NULL, &points, 1) && points > 0) {
+                requested = true;
+                break;
+            }
+        }
+#endif
+        vTaskDelay(pdMS_TO_TICKS(POLL_PERIOD_MS));
+    } while (esp_timer_get_time() < deadline);
+
+#if FAST_BOOT_TOUCH
+    // bsp_display_start() creates its own touch driver and panel IO
+    if (tp) {
+        esp_lcd_touch_del(tp);
+        esp_lcd_panel_io_del(tp_io);
+    }
+#endif
+    if (gpio >= 0) {
+        gpio_reset_pin(gpio);
+    }
+    return requested;
+}
+#endif
+
+void fast_boot_try(void)
+{
+#if CONFIG_GRAPHICAL_BOOTLOADER_FAST_BOOT
+    // Returning from an application is a software reset, show the menu then
+    if (esp_reset_reason() != ESP_RST_POWERON) {
+        return;
+    }
+
+    const esp_partition_t *partition = fast_boot_last_slot();
+    if (partition == NULL) {
+        return;
+    }
+
+    if (fast_boot_menu_requested()) {
+        ESP_LOGI(TAG, "Menu requested, skipping fast boot");
+        return;
+    }
+
+    if (esp_ota_set_boot_partition(partition) == ESP_OK) {
+        ESP_LOGI(TAG, "Fast boot to %s", partition->label);
+        boot_trace_mark(BOOT_STAGE_FAST_BOOT);
+        esp_restart();
+    }
+    ESP_LOGE(TAG, "Failed to set boot partition to %s", partition->label);
+#endif
+}
@@ -0,0 +1,14 @@
+#pragma once
+
+#include "esp_err.h"
+#include "esp_partition.h"
+
+/* Initialize NVS used to remember the last selected application */
+esp_err_t fast_boot_init(void);
+
+/* Boot into the last selected application unless the user asks for the menu.
+ * Returns only when the menu should be shown. */
+void fast_boot_try(void);
+
+/* Remember the application partition selected from the menu */
+esp_err_t fast_boot_remember_slot(const esp_partition_t *partition);
@@ -8,6 +8,10 @@
 #include "bsp/esp-bsp.h"
 #include "lvgl.h"
 #include "esp_log.h"
+#include "fast_boot.h"
+#include "boot_trace.h"
+#include "app_registry.h"
+#include "app_install.h"
 
 extern void bootloader_ui(lv_obj_t *scr);
 
@@ -15,14 +19,34 @@ void app_main(void)
 {
     ESP_LOGI("bootloader", "Starting 3rd stage bootloader...");
 
-    bsp_display_start();
+    boot_trace_init();
+    boot_trace_mark(BOOT_STAGE_APP_MAIN);
+    boot_trace_dump();
+
+    ESP_ERROR_CHECK(fast_boot_init());
+    // Does not return when switching straight to the last used application
+    fast_boot_try();
+
+    if (app_registry_init() != ESP_OK) {
+        ESP_LOGW("bootloader", "No applications found in OTA partitions");
+    }
+
+    boot_trace_mark(BOOT_STAGE_DISPLAY_START);
+    lv_display_t *disp = bsp_display_start();
+    boot_trace_mark(BOOT_STAGE_DISPLAY_READY);
 
     bsp_display_lock(0);
+    boot_trace_watch_first_frame(disp);
     lv_obj_t *scr = lv_disp_get_scr_act(NULL);
     bootloader_ui(scr);
 
     bsp_display_unlock();
     bsp_display_backlight_on();
+    boot_trace_mark(BOOT_STAGE_BACKLIGHT_ON);
+
+#if CONFIG_GRAPHICAL_BOOTLOADER_SERIAL_INSTALL
+    app_install_serial_start();
+#endif
      // Enter the main loop to process LVGL tasks
     while (1) {
         vTaskDelay(pdMS_TO_TICKS(1000));
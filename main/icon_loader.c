@@ -0,0 +1,273 @@
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include "lvgl.h"
+#include "bsp/esp-bsp.h"
+#include "src/libs/lz4/lz4.h"
+#include "icon_loader.h"
+
+#define ICON_CACHE_ENTRIES      CONFIG_GRAPHICAL_BOOTLOADER_ICON_CACHE_ENTRIES
+#define PREFETCH_QUEUE_LEN      4
+#define PREFETCH_TASK_STACK     4096
+
+typedef struct {
+    const void *src;
+    lv_image_dsc_t dsc;
+    uint8_t *buf;
+    uint32_t capacity;
+    uint32_t last_used;
+} icon_slot_t;
+
+// Leads the data of compressed images made by LVGLImage.py, see lv_image_compressed_t
+typedef struct {
+    uint32_t method;            // lv_image_compress_t in the low 4 bits
+    uint32_t compressed_size;
+    uint32_t decompressed_size;
+} icon_compressed_header_t;
+
+static const char *TAG = "icon_loader";
+
+static icon_slot_t s_slots[ICON_CACHE_ENTRIES];
+// Slot shown by the image widget, never evicted
+static icon_slot_t *s_pinned = NULL;
+static uint32_t s_use_counter = 0;
+static icon_loader_stats_t s_stats;
+static QueueHandle_t s_prefetch_queue = NULL;
+// Owned by the prefetch task, which decompresses into it without the display lock
+static icon_slot_t s_staging;
+
+static bool icon_needs_decode(const void *src)
+{
+    if (src == NULL || lv_image_src_get_type(src) != LV_IMAGE_SRC_VARIABLE) {
+        return false;
+    }
+    const lv_image_dsc_t *img = src;
+    return (img->header.flags & LV_IMAGE_FLAGS_COMPRESSED) || LV_COLOR_FORMAT_IS_INDEXED(img->header.cf);
+}
+
+static icon_slot_t *icon_cache_find(const void *src)
+{
+    for (size_t i = 0; i < ICON_CACHE_ENTRIES; i++) {
+        if (s_slots[i].src == src) {
+            return &s_slots[i];
+        }
+    }
+    return NULL;
+}
+
+static icon_slot_t *icon_cache_victim(void)
+{
+    icon_slot_t *victim = NULL;
+    for (size_t i = 0; i < ICON_CACHE_ENTRIES; i++) {
+        icon_slot_t *slot = &s_slots[i];
+        if (slot == s_pinned) {
+            continue;
+        }
+        if (slot->src == NULL) {
+            return slot;
+        }
+        if (victim == NULL || slot->last_used < victim->last_used) {
+            victim = slot;
+        }
+    }
+    return victim;
+}
+
+static bool icon_slot_reserve(icon_slot_t *slot, uint32_t size)
+{
+    if (slot->capacity >= size) {
+        return true;
+    }
+
+    heap_caps_free(slot->buf);
+    slot->buf = heap_caps_malloc(size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (slot->buf == NULL) {
+        slot->buf = heap_caps_malloc(size, MALLOC_CAP_DEFAULT);
+    }
+    slot->capacity = slot->buf ? size : 0;
+    return slot->buf != NULL;
+}
+
+/*
+ * Decompress an LZ4 icon into out->buf and describe it in out->dsc. Only uses the heap,
+ * not LVGL, so it runs without the display lock. Returns false for other icons.
+ */
+static bool icon_decompress(const void *src, icon_slot_t *out)
+{
+    const lv_image_dsc_t *img = src;
+    icon_compressed_header_t header;
+    if (!(img->header.flags & LV_IMAGE_FLAGS_COMPRESSED) || img->data_size < sizeof(header)) {
+        return false;
+    }
+    memcpy(&header, img->data, sizeof(header));
+    if ((header.method & 0xf) != LV_IMAGE_COMPRESS_LZ4 || header.compressed_size != img->data_size - sizeof(header)) {
+        return false;
+    }
+    if (!icon_slot_reserve(out, header.decompressed_size)) {
+        return false;
+    }
+    int size = LZ4_decompress_safe((const char *) img->data + sizeof(header), (char *) out->buf,
+                                   (int) header.compressed_size, (int) header.decompressed_size);
+    if (size != (int) header.decompressed_size) {
+        ESP_LOGW(TAG, "Failed to decompress icon %p", src);
+        return false;
+    }
+    out->dsc.header = img->header;
+    out->dsc.header.flags &= ~LV_IMAGE_FLAGS_COMPRESSED;
+    out->dsc.data_size = header.decompressed_size;
+    out->dsc.data = out->buf;
+    return true;
+}
+
+/* Move the decompressed icon in staging into the least recently used slot. Caller holds the display lock. */
+static icon_slot_t *icon_cache_adopt(const void *src, icon_slot_t *staging)
+{
+    icon_slot_t *slot = icon_cache_victim();
+    if (slot == NULL) {
+        return NULL;
+    }
+    // LVGL caches images by source pointer, forget what this slot held before
+    lv_image_cache_drop(&slot->dsc);
+
+    // Swap the buffers, the slot's old one is reused for the next decompression
+    uint8_t *buf = slot->buf;
+    uint32_t capacity = slot->capacity;
+    slot->buf = staging->buf;
+    slot->capacity = staging->capacity;
+    staging->buf = buf;
+    staging->capacity = capacity;
+
+    slot->dsc = staging->dsc;
+    slot->dsc.header.flags &= LV_IMAGE_FLAGS_PREMULTIPLIED;
+    slot->dsc.data = slot->buf;
+    slot->src = src;
+    slot->last_used = ++s_use_counter;
+    return slot;
+}
+
+/* Decode decode_src (src itself, or its decompressed copy) into the least recently used slot
+ * as src. Caller holds the display lock. */
+static icon_slot_t *icon_cache_load(const void *src, const void *decode_src)
+{
+    icon_slot_t *slot = icon_cache_victim();
+    if (slot == NULL) {
+        return NULL;
+    }
+
+    lv_image_decoder_dsc_t decoder_dsc;
+    if (lv_image_decoder_open(&decoder_dsc, decode_src, NULL) != LV_RESULT_OK || decoder_dsc.decoded == NULL) {
+        ESP_LOGW(TAG, "Failed to decode icon %p", src);
+        return NULL;
+    }
+
+    const lv_draw_buf_t *decoded = decoder_dsc.decoded;
+    // LVGL caches images by source pointer, forget what this slot held before
+    lv_image_cache_drop(&slot->dsc);
+    slot->src = NULL;
+
+    if (icon_slot_reserve(slot, decoded->data_size)) {
+        memcpy(slot->buf, decoded->data, decoded->data_size);
+        slot->dsc.header = decoded->header;
+        slot->dsc.header.flags &= LV_IMAGE_FLAGS_PREMULTIPLIED;
+        slot->dsc.data_size = decoded->data_size;
+        slot->dsc.data = slot->buf;
+        slot->src = src;
+        slot->last_used = ++s_use_counter;
+    }
+
+    lv_image_decoder_close(&decoder_dsc);
+    // The decoded copy lives in the slot now, do not keep a second one in the LVGL cache
+    lv_image_cache_drop(decode_src);
+    return slot->src ? slot : NULL;
+}
+
+const void *icon_loader_get(const void *src)
+{
+    if (!icon_needs_decode(src)) {
+        return src;
+    }
+
+    icon_slot_t *slot = icon_cache_find(src);
+    if (slot) {
+        s_stats.hits++;
+        slot->last_used = ++s_use_counter;
+    } else {
+        s_stats.misses++;
+        slot = icon_cache_load(src, src);
+    }
+
+    if (slot == NULL) {
+        return src;
+    }
+    s_pinned = slot;
+    return &slot->dsc;
+}
+
+/*
+ * The display lock is only held to look up the cache and to publish the icon. LZ4, the
+ * costly part, runs unlocked so rendering and input go on meanwhile. Palette icons are
+ * expanded by the LVGL decoder, under the lock, from the decompressed copy.
+ */
+static void icon_prefetch_task(void *param)
+{
+    const void *src;
+    while (1) {
+        if (!xQueueReceive(s_prefetch_queue, &src, portMAX_DELAY)) {
+            continue;
+        }
+        bsp_display_lock(0);
+        bool cached = icon_cache_find(src) != NULL;
+        bsp_display_unlock();
+        if (cached) {
+            continue;
+        }
+
+        bool decompressed = icon_decompress(src, &s_staging);
+
+        bsp_display_lock(0);
+        if (icon_cache_find(src) == NULL) {
+            icon_slot_t *slot;
+            if (decompressed && !LV_COLOR_FORMAT_IS_INDEXED(s_staging.dsc.header.cf)) {
+                slot = icon_cache_adopt(src, &s_staging);
+            } else {
+                slot = icon_cache_load(src, decompressed ? (const void *) &s_staging.dsc : src);
+            }
+            if (slot) {
+                s_stats.prefetches++;
+            }
+        }
+        bsp_display_unlock();
+    }
+}
+
+void icon_loader_prefetch(const void *left, const void *right)
+{
+    if (s_prefetch_queue == NULL) {
+        s_prefetch_queue = xQueueCreate(PREFETCH_QUEUE_LEN, sizeof(const void *));
+        if (s_prefetch_queue == NULL) {
+            ESP_LOGE(TAG, "Failed to create icon prefetch queue");
+            return;
+        }
+        if (xTaskCreate(icon_prefetch_task, "icon_prefetch", PREFETCH_TASK_STACK, NULL, tskIDLE_PRIORITY + 1, NULL) != pdPASS) {
+            ESP_LOGE(TAG, "Failed to start icon prefetch task");
+            vQueueDelete(s_prefetch_queue);
+            s_prefetch_queue = NULL;
+            return;
+        }
+    }
+
+    const void *srcs[] = { left, right };
+    for (size_t i = 0; i < sizeof(srcs) / sizeof(srcs[0]); i++) {
+        if (icon_needs_decode(srcs[i])) {
+            xQueueSend(s_prefetch_queue, &srcs[i], 0);
+        }
+    }
+}
+
+void icon_loader_get_stats(icon_loader_stats_t *stats)
+{
+    *stats = s_stats;
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <stdint.h>
+
+typedef struct {
+    uint32_t hits;
+    uint32_t misses;
+    uint32_t prefetches;
+} icon_loader_stats_t;
+
+/* Return an image source for lv_img_set_src(). Compressed and palette icons are decoded
+ * into a small LRU cache, other sources are returned unchanged. The returned icon stays
+ * cached until another icon is requested. Must be called with the display lock held. */
+const void *icon_loader_get(const void *src);
+
+/* Decode the icons in a low priority background task so a following icon_loader_get() hits */
+void icon_loader_prefetch(const void *left, const void *right);
+
+void icon_loader_get_stats(icon_loader_stats_t *stats);
@@ -0,0 +1,201 @@
+#include <assert.h>
+#include <stdlib.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "menu_input.h"
+
+#define INPUT_QUEUE_LEN         16
+#define INPUT_TIMER_PERIOD_MS   10
+
+// Auto-repeat starts slow and accelerates while an arrow is held
+#define REPEAT_DELAY_US         400000
+#define REPEAT_START_US         200000
+#define REPEAT_MIN_US           60000
+
+// Minimum time between two accepted presses of one source, per input device type.
+// Rotary encoder detents bounce for 1-5 ms. Keypad keys are scanned and settle within
+// 20 ms, and the BSP buttons on GPIO or ADC ladders bounce up to 30 ms. Touch controllers
+// report at 60-100 Hz, so 40 ms covers a finger lifting and landing within one report.
+#define DEBOUNCE_ENCODER_US     5000
+#define DEBOUNCE_KEYPAD_US      20000
+#define DEBOUNCE_BUTTON_US      30000
+#define DEBOUNCE_POINTER_US     40000
+
+// Fling steps start fast and slow down like a decelerating wheel
+#define FLING_START_US          40000
+#define FLING_MAX_ITEMS         16
+
+typedef enum {
+    INPUT_EVENT_PRESS,
+    INPUT_EVENT_RELEASE,
+    INPUT_EVENT_FLING,
+    INPUT_EVENT_STOP,
+} input_event_type_t;
+
+typedef struct {
+    uint8_t type;
+    uint8_t src;
+    int8_t direction;
+    uint8_t items;
+    int64_t time;
+} input_event_t;
+
+static const char *TAG = "menu_input";
+
+static QueueHandle_t s_queue = NULL;
+static menu_input_step_cb_t s_step_cb = NULL;
+static int64_t s_debounce_us = 0;
+static int64_t s_last_accept[MENU_INPUT_SRC_MAX];
+
+static menu_input_src_t s_held_src = MENU_INPUT_SRC_MAX;
+static int s_held_direction = 0;
+static int64_t s_next_repeat = 0;
+static int64_t s_repeat_interval = 0;
+
+static int s_fling_direction = 0;
+static int s_fling_pending = 0;
+static int64_t s_next_fling = 0;
+static int64_t s_fling_interval = 0;
+
+static int64_t menu_input_debounce_for(lv_indev_type_t indev_type)
+{
+    switch (indev_type) {
+    case LV_INDEV_TYPE_ENCODER:
+        return DEBOUNCE_ENCODER_US;
+    case LV_INDEV_TYPE_KEYPAD:
+        return DEBOUNCE_KEYPAD_US;
+    case LV_INDEV_TYPE_BUTTON:
+        return DEBOUNCE_BUTTON_US;
+    case LV_INDEV_TYPE_POINTER:
+    default:
+        return DEBOUNCE_POINTER_US;
+    }
+}
+
+static void menu_input_post(const input_event_t *event)
+{
+    if (s_queue && xQueueSend(s_queue, event, 0) != pdTRUE) {
+        ESP_LOGW(TAG, "Input queue full, event dropped");
+    }
+}
+
+void menu_input_post_press(menu_input_src_t src, int direction)
+{
+    input_event_t event = {
+        .type = INPUT_EVENT_PRESS,
+        .src = src,
+        .direction = direction < 0 ? -1 : 1,
+        .time = esp_timer_get_time(),
+    };
+    menu_input_post(&event);
+}
+
+void menu_input_post_release(menu_input_src_t src)
+{
+    input_event_t event = {
+        .type = INPUT_EVENT_RELEASE,
+        .src = src,
+        .time = esp_timer_get_time(),
+    };
+    menu_input_post(&event);
+}
+
+void menu_input_post_fling(int direction, int items)
+{
+    input_event_t event = {
+        .type = INPUT_EVENT_FLING,
+        .src = MENU_INPUT_SRC_FLING,
+        .direction = direction < 0 ? -1 : 1,
+        .items = items < 1 ? 1 : (items > FLING_MAX_ITEMS ? FLING_MAX_ITEMS : items),
+        .time = esp_timer_get_time(),
+    };
+    menu_input_post(&event);
+}
+
+void menu_input_stop(void)
+{
+    input_event_t event = {
+        .type = INPUT_EVENT_STOP,
+        .time = esp_timer_get_time(),
+    };
+    menu_input_post(&event);
+}
+
+static void menu_input_handle(const input_event_t *event)
+{
+    switch (event->type) {
+    case INPUT_EVENT_PRESS:
+        if (event->time - s_last_accept[event->src] < s_debounce_us) {
+            return;
+        }
+        s_last_accept[event->src] = event->time;
+        s_fling_pending = 0;
+        s_held_src = event->src;
+        s_held_direction = event->direction;
+        s_next_repeat = event->time + REPEAT_DELAY_US;
+        s_repeat_interval = REPEAT_START_US;
+        s_step_cb(event->direction);
+        break;
+    case INPUT_EVENT_RELEASE:
+        if (event->src == s_held_src) {
+            s_held_src = MENU_INPUT_SRC_MAX;
+            s_held_direction = 0;
+        }
+        break;
+    case INPUT_EVENT_FLING:
+        if (event->time - s_last_accept[event->src] < s_debounce_us) {
+            return;
+        }
+        s_last_accept[event->src] = event->time;
+        s_fling_direction = event->direction;
+        s_fling_pending = event->items - 1;
+        s_fling_interval = FLING_START_US;
+        s_next_fling = event->time + s_fling_interval;
+        s_step_cb(event->direction);
+        break;
+    case INPUT_EVENT_STOP:
+    default:
+        s_held_src = MENU_INPUT_SRC_MAX;
+        s_held_direction = 0;
+        s_fling_pending = 0;
+        break;
+    }
+}
+
+static void menu_input_timer_cb(lv_timer_t *timer)
+{
+    input_event_t event;
+    while (xQueueReceive(s_queue, &event, 0) == pdTRUE) {
+        menu_input_handle(&event);
+    }
+
+    int64_t now = esp_timer_get_time();
+    if (s_held_direction != 0 && now >= s_next_repeat) {
+        s_step_cb(s_held_direction);
+        s_repeat_interval = s_repeat_interval * 3 / 4;
+        if (s_repeat_interval < REPEAT_MIN_US) {
+            s_repeat_interval = REPEAT_MIN_US;
+        }
+        s_next_repeat = now + s_repeat_interval;
+    }
+
+    if (s_fling_pending > 0 && now >= s_next_fling) {
+        s_step_cb(s_fling_direction);
+        s_fling_pending--;
+        s_fling_interval = s_fling_interval * 3 / 2;
+        s_next_fling = now + s_fling_interval;
+    }
+}
+
+void menu_input_init(lv_indev_type_t indev_type, menu_input_step_cb_t step_cb)
+{
+    s_step_cb = step_cb;
+    s_debounce_us = menu_input_debounce_for(indev_type);
+    if (s_queue == NULL) {
+        s_queue = xQueueCreate(INPUT_QUEUE_LEN, sizeof(input_event_t));
+        assert(s_queue != NULL);
+        lv_timer_create(menu_input_timer_cb, INPUT_TIMER_PERIOD_MS, NULL);
+    }
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include "lvgl.h"
+
+typedef enum {
+    MENU_INPUT_SRC_PREV = 0,
+    MENU_INPUT_SRC_NEXT,
+    MENU_INPUT_SRC_FLING,
+    MENU_INPUT_SRC_MAX,
+} menu_input_src_t;
+
+/* Called from the LVGL task with the number of items to move, negative moves left */
+typedef void (*menu_input_step_cb_t)(int steps);
+
+/* Start the input engine. Debounce times are picked for the given input device type. */
+void menu_input_init(lv_indev_type_t indev_type, menu_input_step_cb_t step_cb);
+
+/* Queue a press or release of an arrow source. Safe to call from any task. */
+void menu_input_post_press(menu_input_src_t src, int direction);
+void menu_input_post_release(menu_input_src_t src);
+
+/* Queue a fling moving by the given number of items, with decelerating steps */
+void menu_input_post_fling(int direction, int items);
+
+/* Stop auto-repeat and pending fling steps, e.g. before launching an app */
+void menu_input_stop(void);
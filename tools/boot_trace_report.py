@@ -0,0 +1,102 @@
+#!/usr/bin/env python3
+"""Turn "BT,<boot>,<stage>,<us>" lines from the bootloader console into a latency table.
+
+Usage:
+    idf.py monitor | tee boot.log
+    python tools/boot_trace_report.py boot.log
+    python tools/boot_trace_report.py boot.log --baseline previous_build.log
+"""
+
+import argparse
+import re
+import statistics
+import sys
+
+LINE_RE = re.compile(r'BT,(\d+),(\w+),(\d+)')
+
+# Order in which the stages are listed in the report
+STAGES = [
+    'app_main',
+    'fast_boot',
+    'display_start',
+    'display_ready',
+    'ui_start',
+    'ui_ready',
+    'backlight_on',
+    'first_frame',
+    'app_switch',
+]
+
+
+def parse(stream):
+    """Return {boot: {stage: us}}. The same entry printed by several dumps is kept once."""
+    boots = {}
+    for line in stream:
+        match = LINE_RE.search(line)
+        if not match:
+            continue
+        boot, stage, time_us = int(match.group(1)), match.group(2), int(match.group(3))
+        boots.setdefault(boot, {})[stage] = time_us
+    return boots
+
+
+def stage_latencies(boots):
+    """Return {stage: [latency_us, ...]} where latency is measured from the previous stage in time."""
+    latencies = {}
+    for stages in boots.values():
+        prev = 0
+        for stage, time_us in sorted(stages.items(), key=lambda item: item[1]):
+            latencies.setdefault(stage, []).append(time_us - prev)
+            prev = time_us
+    return latencies
+
+
+def load(path):
+    with open(path, errors='replace') as f:
+        return parse(f)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('log', nargs='?', help='console log, stdin when omitted')
+    parser.add_argument('--baseline', help='console log of a previous build to compare against')
+    args = parser.parse_args()
+
+    boots = load(args.log) if args.log else parse(sys.stdin)
+    if not boots:
+        print('No boot trace entries found', file=sys.stderr)
+        return 1
+
+    latencies = stage_latencies(boots)
+    baseline = stage_latencies(load(args.baseline)) if args.baseline else {}
+
+    header = f'{"stage":<14} {"boots":>5} {"median ms":>10} {"min ms":>8} {"max ms":>8}'
+    if baseline:
+        header += f' {"base ms":>8} {"delta ms":>9}'
+    print(f'{len(boots)} boot(s)')
+    print(header)
+    print('-' * len(header))
+
+    total = 0.0
+    for stage in STAGES:
+        values = latencies.get(stage)
+        if not values:
+            continue
+        median = statistics.median(values) / 1000
+        total += median
+        row = f'{stage:<14} {len(values):>5} {median:>10.1f} {min(values) / 1000:>8.1f} {max(values) / 1000:>8.1f}'
+        if baseline:
+            if stage in baseline:
+                base = statistics.median(baseline[stage]) / 1000
+                row += f' {base:>8.1f} {median - base:>+9.1f}'
+            else:
+                row += f' {"-":>8} {"-":>9}'
+        print(row)
+
+    print('-' * len(header))
+    print(f'{"total":<14} {"":>5} {total:>10.1f}')
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,182 @@
+#!/usr/bin/env python3
+"""Flash only the slots, and within a slot only the 4 KB sectors, which changed.
+
+The manifest written by tools/merge_images.py is compared either with the manifest of
+the last successful flash (merged/last_flash.json, default) or with the flash content
+read back from the device as MD5 per slot and per sector (--from-device).
+Changed sectors are merged into runs and written by a single esptool call.
+
+The cached manifest does not know about writes made by anything else, such as an other
+machine or an application installed over serial (tools/pack_app.py): sectors rewritten
+that way are skipped as unchanged. Use --from-device after such writes; when it finds a
+difference the cached manifest is deleted.
+
+Usage:
+    python tools/flash_changed.py --merged-dir build.esp-box-3/merged --port /dev/ttyACM0
+    python tools/flash_changed.py --merged-dir build.esp-box-3/merged --port /dev/ttyACM0 --from-device
+    python tools/flash_changed.py --merged-dir build.esp-box-3/merged --dry-run
+"""
+
+import argparse
+import hashlib
+import json
+import os
+import shutil
+import subprocess
+import sys
+
+LAST_FLASH = 'last_flash.json'
+RUNS_DIR = 'changed'
+ESP_IMAGE_MAGIC = 0xE9
+ESP_IMAGE_HASH_APPENDED = 23    # offset of the hash_appended byte of the extended header
+
+
+def load_json(path):
+    with open(path) as f:
+        return json.load(f)
+
+
+def changed_from_manifest(manifest, last):
+    """Yield (segment, [sector index]) for sectors whose SHA-256 differs from the last flash."""
+    previous = {(s['offset'], s['name']): s for s in last['segments']} if last else {}
+    for segment in manifest['segments']:
+        old = previous.get((segment['offset'], segment['name']))
+        if old and old['sha256'] == segment['sha256']:
+            continue
+        old_sectors = old['sectors'] if old else []
+        yield segment, [i for i, sector in enumerate(segment['sectors'])
+                        if i >= len(old_sectors) or old_sectors[i] != sector]
+
+
+def normalize_bootloader(data):
+    """Blank what esptool write_flash rewrites in the bootloader image: the flash mode and
+    flash size/frequency header bytes and, when appended, the SHA-256 of the image."""
+    if len(data) <= ESP_IMAGE_HASH_APPENDED or data[0] != ESP_IMAGE_MAGIC:
+        return data
+    data = bytearray(data)
+    data[2:4] = bytes(2)
+    if data[ESP_IMAGE_HASH_APPENDED] == 1:
+        data[-32:] = bytes(32)
+    return bytes(data)
+
+
+def changed_from_device(manifest, merged_dir, args):
+    """Yield (segment, [sector index]) for sectors whose MD5 differs from the flash content."""
+    import esptool
+    from esptool.util import flash_size_bytes
+
+    flash_args = manifest['write_flash_args']
+    flash_size = flash_args[flash_args.index('--flash_size') + 1]
+    sector_size = manifest['sector_size']
+
+    # The loader closes its port when leaving the with block, the stub loader shares it
+    with esptool.detect_chip(args.port) as esp:
+        esp = esp.run_stub()
+        esp.change_baud(args.baud)
+        esp.flash_spi_attach(0)
+        esp.flash_set_parameters(flash_size_bytes(flash_size))
+        for segment in manifest['segments']:
+            with open(os.path.join(merged_dir, segment['file']), 'rb') as f:
+                data = f.read()
+            offset = segment['offset']
+            if offset == esp.BOOTLOADER_FLASH_OFFSET:
+                # Never equal byte for byte, compare what write_flash leaves unchanged
+                local = normalize_bootloader(data)
+                device = normalize_bootloader(esp.read_flash(offset, len(data)))
+                yield segment, [i for i, pos in enumerate(range(0, len(data), sector_size))
+                                if local[pos:pos + sector_size] != device[pos:pos + sector_size]]
+                continue
+            if esp.flash_md5sum(offset, len(data)) == hashlib.md5(data).hexdigest():
+                continue
+            changed = []
+            for i, pos in enumerate(range(0, len(data), sector_size)):
+                chunk = data[pos:pos + sector_size]
+                if esp.flash_md5sum(offset + pos, len(chunk)) != hashlib.md5(chunk).hexdigest():
+                    changed.append(i)
+            yield segment, changed
+        # Leave the device running its application, as esptool does after a command
+        esp.hard_reset()
+
+
+def sector_runs(segment, sectors, sector_size):
+    """Group consecutive sector indexes into (offset, start, end) byte ranges of the segment."""
+    runs = []
+    for i in sectors:
+        start = i * sector_size
+        end = min(start + sector_size, segment['size'])
+        if runs and runs[-1][2] == start:
+            runs[-1] = (runs[-1][0], runs[-1][1], end)
+        else:
+            runs.append((segment['offset'] + start, start, end))
+    return runs
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument('--merged-dir', required=True, help='merged directory written by merge_images.py')
+    parser.add_argument('--port', help='serial port of the device')
+    parser.add_argument('--baud', type=int, default=921600)
+    parser.add_argument('--from-device', action='store_true',
+                        help='compare with the flash content instead of the last flash manifest')
+    parser.add_argument('--dry-run', action='store_true', help='only report what would be written')
+    args = parser.parse_args()
+
+    manifest = load_json(os.path.join(args.merged_dir, 'manifest.json'))
+    sector_size = manifest['sector_size']
+    last_path = os.path.join(args.merged_dir, LAST_FLASH)
+
+    if args.from_device:
+        if not args.port:
+            sys.exit('--from-device needs --port')
+        changes = list(changed_from_device(manifest, args.merged_dir, args))
+        if any(sectors for _, sectors in changes) and os.path.exists(last_path):
+            # Something else wrote to the device, the cached manifest is wrong
+            os.remove(last_path)
+    else:
+        last = load_json(last_path) if os.path.exists(last_path) else None
+        if last and last['chip'] != manifest['chip']:
+            last = None
+        changes = list(changed_from_manifest(manifest, last))
+
+    pending = []
+    total = sum(segment['size'] for segment in manifest['segments'])
+    changed_bytes = 0
+    for segment, sectors in changes:
+        if not sectors:
+            continue
+        with open(os.path.join(args.merged_dir, segment['file']), 'rb') as f:
+            data = f.read()
+        runs = sector_runs(segment, sectors, sector_size)
+        size = sum(end - start for _, start, end in runs)
+        changed_bytes += size
+        print(f'{segment["name"]:16s} {len(sectors):4d}/{len(segment["sectors"])} sectors, {size} bytes')
+        pending += [(offset, data[start:end]) for offset, start, end in runs]
+
+    print(f'{changed_bytes} of {total} bytes to write')
+    if not pending or args.dry_run:
+        return
+    if not args.port:
+        sys.exit('--port is required to flash')
+
+    runs_dir = os.path.join(args.merged_dir, RUNS_DIR)
+    shutil.rmtree(runs_dir, ignore_errors=True)
+    os.makedirs(runs_dir)
+    write_args = []
+    for offset, data in pending:
+        name = os.path.join(runs_dir, f'0x{offset:x}.bin')
+        with open(name, 'wb') as f:
+            f.write(data)
+        write_args += [f'0x{offset:x}', name]
+
+    cmd = [sys.executable, '-m', 'esptool', '--chip', manifest['chip'], '--port', args.port,
+           '--baud', str(args.baud), 'write_flash'] + manifest['write_flash_args'] + write_args
+    if subprocess.call(cmd) != 0:
+        sys.exit('Flashing failed')
+
+    # The device now holds exactly this manifest
+    with open(last_path, 'w') as f:
+        json.dump(manifest, f, indent=1)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,190 @@
+#!/usr/bin/env python3
+"""Merge the launcher and the applications into flashable images in one pass.
+
+Flash offsets are taken from the generated partition table and from flasher_args.json
+of the launcher build, so nothing has to be kept in sync with partitions.csv by hand.
+
+Outputs (in --output-dir):
+    combined.bin       flat image starting at 0x0, gaps filled with 0xFF
+    uf2.bin            UF2 image containing only the blocks which carry data
+    merged/flash_args  segment list for "esptool.py write_flash @flash_args",
+                       together with a copy of every segment
+    merged/manifest.json
+                       SHA-256 of every segment and of each of its 4 KB sectors,
+                       used by tools/flash_changed.py
+
+Usage:
+    python tools/merge_images.py --build-dir build.esp-box-3 \\
+        --app ota_0=apps/tic_tac_toe/build.esp-box-3/tic_tac_toe.bin ... \\
+        --data instruments=build.esp-box-3/instruments.bin
+"""
+
+import argparse
+import hashlib
+import json
+import os
+import shutil
+import struct
+import sys
+
+PARTITION_ENTRY = struct.Struct('<2sBBII16sI')
+PARTITION_MAGIC = b'\xaa\x50'
+PARTITION_TYPE_APP = 0x00
+PARTITION_TYPE_DATA = 0x01
+
+APP_IMAGE_MAGIC = 0xE9
+
+UF2_MAGIC_START0 = 0x0A324655
+UF2_MAGIC_START1 = 0x9E5D5157
+UF2_MAGIC_END = 0x0AB16F30
+UF2_FLAG_FAMILY_ID_PRESENT = 0x00002000
+UF2_BLOCK_SIZE = 512
+UF2_PAYLOAD_SIZE = 256
+
+FLASH_SECTOR_SIZE = 4096
+
+# Family IDs from https://github.com/microsoft/uf2/blob/master/utils/uf2families.json
+UF2_FAMILY_IDS = {
+    'esp32': 0x1C5F21B0,
+    'esp32s2': 0xBFDD4EEE,
+    'esp32s3': 0xC47E5767,
+    'esp32c3': 0xD42BA06C,
+    'esp32c6': 0x540DDF62,
+    'esp32h2': 0x332726F6,
+    'esp32p4': 0x3D308E94,
+}
+
+
+def read_partition_table(path):
+    """Return {label: (type, subtype, offset, size)} from a binary partition table."""
+    partitions = {}
+    with open(path, 'rb') as f:
+        data = f.read()
+    for pos in range(0, len(data) - PARTITION_ENTRY.size + 1, PARTITION_ENTRY.size):
+        magic, ptype, subtype, offset, size, label, _flags = PARTITION_ENTRY.unpack_from(data, pos)
+        if magic != PARTITION_MAGIC:
+            break
+        partitions[label.rstrip(b'\x00').decode()] = (ptype, subtype, offset, size)
+    return partitions
+
+
+def load_segments(args):
+    """Return (chip, flash_args, [(offset, name, path)]) sorted by offset."""
+    with open(os.path.join(args.build_dir, 'flasher_args.json')) as f:
+        flasher_args = json.load(f)
+    chip = flasher_args['extra_esptool_args']['chip']
+
+    table_path = os.path.join(args.build_dir, flasher_args['partition-table']['file'])
+    partitions = read_partition_table(table_path)
+    labels = {offset: label for label, (_, _, offset, _) in partitions.items()}
+
+    segments = []
+    for offset, path in flasher_args['flash_files'].items():
+        offset = int(offset, 0)
+        name = labels.get(offset, os.path.splitext(os.path.basename(path))[0])
+        segments.append((offset, name, os.path.join(args.build_dir, path)))
+    images = [(PARTITION_TYPE_APP, image) for image in args.app] + \
+             [(PARTITION_TYPE_DATA, image) for image in args.data]
+    for expected_type, image in images:
+        label, _, path = image.partition('=')
+        if label not in partitions:
+            sys.exit(f'Partition {label} is not in {table_path}')
+        ptype, _subtype, offset, size = partitions[label]
+        if ptype != expected_type:
+            kind = 'an app' if expected_type == PARTITION_TYPE_APP else 'a data'
+            sys.exit(f'Partition {label} is not {kind} partition')
+        image_size = os.path.getsize(path)
+        if image_size > size:
+            sys.exit(f'{path} ({image_size} bytes) does not fit {label} ({size} bytes)')
+        if expected_type == PARTITION_TYPE_APP:
+            with open(path, 'rb') as f:
+                if f.read(1) != bytes([APP_IMAGE_MAGIC]):
+                    sys.exit(f'{path} is not an app image')
+        segments.append((offset, label, path))
+
+    segments.sort()
+    for (offset, _, path), (next_offset, _, next_path) in zip(segments, segments[1:]):
+        if offset + os.path.getsize(path) > next_offset:
+            sys.exit(f'{path} at 0x{offset:x} overlaps {next_path} at 0x{next_offset:x}')
+    return chip, flasher_args['write_flash_args'], segments
+
+
+def write_outputs(output_dir, chip, write_flash_args, segments):
+    manifest = {'chip': chip, 'write_flash_args': write_flash_args,
+                'sector_size': FLASH_SECTOR_SIZE, 'segments': []}
+    merged_dir = os.path.join(output_dir, 'merged')
+    os.makedirs(merged_dir, exist_ok=True)
+
+    family_id = UF2_FAMILY_IDS[chip]
+    total_blocks = sum((os.path.getsize(path) + UF2_PAYLOAD_SIZE - 1) // UF2_PAYLOAD_SIZE
+                       for _, _, path in segments)
+    block_no = 0
+    data_size = 0
+
+    with open(os.path.join(output_dir, 'combined.bin'), 'wb') as flat, \
+            open(os.path.join(output_dir, 'uf2.bin'), 'wb') as uf2, \
+            open(os.path.join(merged_dir, 'flash_args'), 'w') as flash_args:
+        flash_args.write(' '.join(write_flash_args) + '\n')
+
+        for offset, label, path in segments:
+            with open(path, 'rb') as f:
+                data = f.read()
+            data_size += len(data)
+
+            # Flat image: fill the gap up to the segment with erased flash
+            flat.write(b'\xff' * (offset - flat.tell()))
+            flat.write(data)
+
+            # UF2: gaps between segments are simply not emitted
+            for pos in range(0, len(data), UF2_PAYLOAD_SIZE):
+                chunk = data[pos:pos + UF2_PAYLOAD_SIZE]
+                block = struct.pack('<8I', UF2_MAGIC_START0, UF2_MAGIC_START1,
+                                    UF2_FLAG_FAMILY_ID_PRESENT, offset + pos, len(chunk),
+                                    block_no, total_blocks, family_id)
+                block += chunk.ljust(UF2_BLOCK_SIZE - len(block) - 4, b'\x00')
+                block += struct.pack('<I', UF2_MAGIC_END)
+                uf2.write(block)
+                block_no += 1
+
+            # Segment list: copy under a unique name, flashed by offset
+            name = f'0x{offset:x}_{os.path.basename(path)}'
+            shutil.copyfile(path, os.path.join(merged_dir, name))
+            flash_args.write(f'0x{offset:x} {name}\n')
+
+            manifest['segments'].append({
+                'name': label,
+                'offset': offset,
+                'file': name,
+                'size': len(data),
+                'sha256': hashlib.sha256(data).hexdigest(),
+                'sectors': [hashlib.sha256(data[pos:pos + FLASH_SECTOR_SIZE]).hexdigest()
+                            for pos in range(0, len(data), FLASH_SECTOR_SIZE)],
+            })
+
+        flat_size = flat.tell()
+
+    with open(os.path.join(merged_dir, 'manifest.json'), 'w') as f:
+        json.dump(manifest, f, indent=1)
+
+    print(f'{len(segments)} segments, {data_size} bytes of data, '
+          f'flat image {flat_size} bytes ({100 * data_size // flat_size}% used)')
+    for offset, label, path in segments:
+        print(f'  0x{offset:08x} {os.path.getsize(path):9d} {label:16s} {path}')
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument('--build-dir', required=True, help='build directory of the launcher')
+    parser.add_argument('--app', action='append', default=[], metavar='LABEL=BIN',
+                        help='application binary and the partition it goes to')
+    parser.add_argument('--data', action='append', default=[], metavar='LABEL=BIN',
+                        help='data partition image, e.g. instruments=instruments.bin')
+    parser.add_argument('--output-dir', help='defaults to --build-dir')
+    args = parser.parse_args()
+
+    chip, write_flash_args, segments = load_segments(args)
+    write_outputs(args.output_dir or args.build_dir, chip, write_flash_args, segments)
+
+
+if __name__ == '__main__':
+    main()
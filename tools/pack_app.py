@@ -0,0 +1,132 @@
+#!/usr/bin/env python3
+"""Pack an application image for install through the launcher, see main/app_install.h.
+
+The image is split into blocks which are LZ4 compressed independently, so the launcher
+decompresses with a few block sized buffers while writing the OTA slot.
+
+Usage:
+    python tools/pack_app.py apps/calculator/build.esp-box-3/calculator.bin --slot 2 -o calculator.gblz
+    python tools/pack_app.py apps/calculator/build.esp-box-3/calculator.bin --slot 2 --port /dev/ttyACM0
+"""
+
+import argparse
+import hashlib
+import struct
+import sys
+
+MAGIC = b'GBLZ'
+VERSION = 1
+BLOCK_RAW = 0x80000000
+MAX_BLOCK_SIZE = 64 * 1024
+HEADER = struct.Struct('<4sBBHII32s')
+
+# LZ4 block format limits
+MIN_MATCH = 4
+LAST_LITERALS = 5
+MF_LIMIT = 12
+MAX_OFFSET = 65535
+
+
+def lz4_length(out, length):
+    while length >= 255:
+        out.append(255)
+        length -= 255
+    out.append(length)
+
+
+def lz4_sequence(out, literals, offset=0, match_len=0):
+    lit_len = len(literals)
+    extra_match = match_len - MIN_MATCH if match_len else 0
+    out.append((min(lit_len, 15) << 4) | min(extra_match, 15))
+    if lit_len >= 15:
+        lz4_length(out, lit_len - 15)
+    out += literals
+    if match_len:
+        out += struct.pack('<H', offset)
+        if extra_match >= 15:
+            lz4_length(out, extra_match - 15)
+
+
+def lz4_compress_python(data):
+    """Greedy single-probe LZ4 block compressor, used when the lz4 package is not installed."""
+    out = bytearray()
+    table = {}
+    anchor = 0
+    pos = 0
+    limit = len(data) - MF_LIMIT
+    while pos < limit:
+        key = data[pos:pos + MIN_MATCH]
+        ref = table.get(key)
+        table[key] = pos
+        if ref is None or pos - ref > MAX_OFFSET:
+            pos += 1
+            continue
+        match_len = MIN_MATCH
+        max_len = len(data) - LAST_LITERALS - pos
+        while match_len < max_len and data[ref + match_len] == data[pos + match_len]:
+            match_len += 1
+        lz4_sequence(out, data[anchor:pos], pos - ref, match_len)
+        pos += match_len
+        anchor = pos
+    lz4_sequence(out, data[anchor:])
+    return bytes(out)
+
+
+try:
+    import lz4.block
+
+    def lz4_compress(data):
+        return lz4.block.compress(data, mode='high_compression', store_size=False)
+except ImportError:
+    lz4_compress = lz4_compress_python
+
+
+def pack(image, slot, block_size):
+    out = bytearray(HEADER.pack(MAGIC, VERSION, slot, 0, block_size, len(image),
+                                hashlib.sha256(image).digest()))
+    for pos in range(0, len(image), block_size):
+        block = image[pos:pos + block_size]
+        compressed = lz4_compress(block)
+        if len(compressed) < len(block):
+            out += struct.pack('<I', len(compressed)) + compressed
+        else:
+            out += struct.pack('<I', len(block) | BLOCK_RAW) + block
+    return bytes(out)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument('image', help='application .bin')
+    parser.add_argument('--slot', type=int, required=True, help='target ota_N slot')
+    parser.add_argument('--block-size', type=int, default=16 * 1024)
+    parser.add_argument('-o', '--output', help='write the package to a file')
+    parser.add_argument('--port', help='send the package to the launcher over this serial port')
+    parser.add_argument('--baud', type=int, default=115200, help='for UART, ignored by USB Serial/JTAG')
+    args = parser.parse_args()
+
+    if not 0 < args.block_size <= MAX_BLOCK_SIZE:
+        sys.exit(f'Block size must be 1..{MAX_BLOCK_SIZE}')
+    if not args.output and not args.port:
+        sys.exit('Use --output and/or --port')
+
+    with open(args.image, 'rb') as f:
+        image = f.read()
+    if image[:1] != b'\xe9':
+        sys.exit(f'{args.image} is not an app image')
+    package = pack(image, args.slot, args.block_size)
+    print(f'{len(image)} -> {len(package)} bytes ({100 * len(package) // len(image)}%), '
+          f'{(len(image) + args.block_size - 1) // args.block_size} blocks of {args.block_size}')
+
+    if args.output:
+        with open(args.output, 'wb') as f:
+            f.write(package)
+    if args.port:
+        import serial
+        with serial.Serial(args.port, args.baud) as port:
+            port.write(package)
+            port.flush()
+        print(f'Sent to {args.port}, the launcher restarts after the install')
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,139 @@
+#!/usr/bin/env python3
+"""Pack WAV files into the instruments partition image read by the synth piano.
+
+Layout (little endian, see apps/synth_piano/main/synth_sampler.h):
+    header      magic "GBIN", u16 version, u16 count, u32 image size
+    entries     count x (name[16], u32 offset, u32 length, u32 loop_start, u32 loop_end,
+                         u32 sample_rate, u8 root_note, u8 format, u16 reserved)
+    samples     16 bit mono PCM of every instrument, each 4 byte aligned
+
+Lengths and loop points are in samples, loop_end == 0 means the sample plays once.
+Loop points and the root note come from the "smpl" chunk of the WAV when present and can
+be overridden per file:
+
+    python tools/pack_instruments.py -o instruments.bin piano.wav strings.wav:root=57:loop=1200-8400
+"""
+
+import argparse
+import array
+import os
+import struct
+import sys
+import wave
+
+MAGIC = b'GBIN'
+VERSION = 1
+HEADER = struct.Struct('<4sHHI')
+ENTRY = struct.Struct('<16sIIIIIBBH')
+FORMAT_PCM16 = 0
+NAME_SIZE = 16
+DEFAULT_ROOT_NOTE = 60
+
+
+def read_smpl(path):
+    """Return (root_note, loop_start, loop_end) from the smpl chunk, or Nones."""
+    with open(path, 'rb') as f:
+        data = f.read()
+    pos = 12
+    while pos + 8 <= len(data):
+        chunk_id, size = struct.unpack_from('<4sI', data, pos)
+        if chunk_id == b'smpl' and size >= 36:
+            root_note = struct.unpack_from('<I', data, pos + 8 + 12)[0]
+            loops = struct.unpack_from('<I', data, pos + 8 + 28)[0]
+            if loops and size >= 36 + 24:
+                # First loop: id, type, start, end (inclusive), fraction, count
+                _id, _type, start, end = struct.unpack_from('<4I', data, pos + 8 + 36)
+                return root_note, start, end + 1
+            return root_note, None, None
+        pos += 8 + size + (size & 1)
+    return None, None, None
+
+
+def read_wav(path):
+    """Return (mono 16 bit samples, sample rate)."""
+    with wave.open(path, 'rb') as wav:
+        channels = wav.getnchannels()
+        width = wav.getsampwidth()
+        rate = wav.getframerate()
+        frames = wav.readframes(wav.getnframes())
+    if width == 1:
+        values = [(b - 128) << 8 for b in frames]
+    elif width == 2:
+        values = array.array('h', frames)
+        if sys.byteorder != 'little':
+            values.byteswap()
+    elif width == 3:
+        values = [int.from_bytes(frames[i + 1:i + 3], 'little', signed=True) for i in range(0, len(frames), 3)]
+    else:
+        sys.exit(f'{path}: {8 * width} bit samples are not supported')
+    if channels > 1:
+        values = [sum(values[i:i + channels]) // channels for i in range(0, len(values), channels)]
+    return array.array('h', values), rate
+
+
+def parse_source(spec):
+    """'file.wav[:root=N][:loop=START-END][:name=NAME]' -> dict"""
+    path, *options = spec.split(':')
+    source = {'path': path}
+    for option in options:
+        key, _, value = option.partition('=')
+        if key == 'root':
+            source['root'] = int(value)
+        elif key == 'loop':
+            start, _, end = value.partition('-')
+            source['loop'] = (int(start), int(end))
+        elif key == 'name':
+            source['name'] = value
+        else:
+            sys.exit(f'{spec}: unknown option {key}')
+    return source
+
+
+def pack(sources):
+    entries = []
+    samples = bytearray()
+    data_offset = HEADER.size + ENTRY.size * len(sources)
+    for source in sources:
+        path = source['path']
+        pcm, rate = read_wav(path)
+        root, loop_start, loop_end = read_smpl(path)
+        if 'loop' in source:
+            loop_start, loop_end = source['loop']
+        if loop_start is None:
+            loop_start, loop_end = 0, 0
+        if loop_end and not 0 <= loop_start < loop_end <= len(pcm):
+            sys.exit(f'{path}: loop {loop_start}-{loop_end} is outside the {len(pcm)} samples')
+        root = source.get('root', root if root is not None else DEFAULT_ROOT_NOTE)
+        name = source.get('name', os.path.splitext(os.path.basename(path))[0])
+
+        if sys.byteorder != 'little':
+            pcm.byteswap()
+        offset = data_offset + len(samples)
+        samples += pcm.tobytes()
+        samples += b'\x00' * (-len(samples) % 4)
+        entries.append(ENTRY.pack(name.encode()[:NAME_SIZE - 1], offset, len(pcm), loop_start, loop_end,
+                                  rate, root, FORMAT_PCM16, 0))
+        loop = f'loop {loop_start}-{loop_end}' if loop_end else 'one shot'
+        print(f'  {name:15s} {len(pcm):8d} samples at {rate} Hz, root note {root}, {loop}')
+
+    size = data_offset + len(samples)
+    return HEADER.pack(MAGIC, VERSION, len(sources), size) + b''.join(entries) + samples
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument('wav', nargs='+', help='file.wav[:root=N][:loop=START-END][:name=NAME]')
+    parser.add_argument('-o', '--output', required=True, help='partition image')
+    parser.add_argument('--size', type=lambda s: int(s, 0), help='partition size to check against')
+    args = parser.parse_args()
+
+    image = pack([parse_source(spec) for spec in args.wav])
+    if args.size and len(image) > args.size:
+        sys.exit(f'{len(image)} bytes of instruments do not fit the {args.size} byte partition')
+    with open(args.output, 'wb') as f:
+        f.write(image)
+    print(f'{len(args.wav)} instruments, {len(image)} bytes')
+
+
+if __name__ == '__main__':
+    main()